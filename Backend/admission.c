@@ -0,0 +1,260 @@
+/******************************************************************************
+ * admission.c
+ *
+ * Keeps one noisy client from starving the single-threaded accept loop.
+ *
+ *   - Every connection takes a token from its IP's bucket before the
+ *     request is even read; an empty bucket gets an immediate 429.
+ *   - Requests made under a logged-in session also take a token from that
+ *     user's bucket, so one account cannot hog the server from many IPs.
+ *   - Exports share a fixed number of slots and hold theirs until the
+ *     stream ends. Only work that runs beside the accept loop needs one:
+ *     /transactions and search finish inside the loop, one at a time, so
+ *     a slot cap could never refuse them and they rely on the buckets.
+ *
+ * Buckets live in fixed open-addressing tables of 12-byte entries, split
+ * into stripes with one mutex each. A key is probed only within its own
+ * stripe; when the probe window is full the least recently used entry is
+ * recycled - an idle bucket would have refilled to full anyway.
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "admission.h"
+
+#define ADMISSION_IP_RATE        20.0f   // tokens per second
+#define ADMISSION_IP_BURST       40.0f
+#define ADMISSION_SESSION_RATE   50.0f
+#define ADMISSION_SESSION_BURST  100.0f
+#define ADMISSION_MAX_EXPENSIVE  4       // concurrent exports
+
+#define ADMISSION_IP_SLOTS       4096
+#define ADMISSION_SESSION_SLOTS  1024
+#define ADMISSION_STRIPES        16
+#define ADMISSION_PROBE          8
+
+struct bucket {
+    uint32_t key;               // 0 = empty slot
+    uint32_t stamp_ms;          // last refill (wraps; only differences are used)
+    float tokens;
+};
+
+struct bucket_table {
+    float rate;                 // tokens per second
+    float burst;                // bucket capacity
+    size_t slots;               // multiple of ADMISSION_STRIPES
+    struct bucket *entries;
+    pthread_mutex_t locks[ADMISSION_STRIPES];
+};
+
+static struct bucket g_ip_entries[ADMISSION_IP_SLOTS];
+static struct bucket g_session_entries[ADMISSION_SESSION_SLOTS];
+
+#define STRIPE_LOCKS_INIT { \
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, \
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, \
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, \
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER }
+
+static struct bucket_table g_ip_table = {
+    ADMISSION_IP_RATE, ADMISSION_IP_BURST, ADMISSION_IP_SLOTS, g_ip_entries, STRIPE_LOCKS_INIT
+};
+static struct bucket_table g_session_table = {
+    ADMISSION_SESSION_RATE, ADMISSION_SESSION_BURST, ADMISSION_SESSION_SLOTS, g_session_entries, STRIPE_LOCKS_INIT
+};
+
+static int g_rate_limits = 1;
+static atomic_int g_expensive_in_flight;
+static atomic_ullong g_admitted;
+static atomic_ullong g_shed_ip;
+static atomic_ullong g_shed_session;
+static atomic_ullong g_shed_busy;
+
+// -------------------------------------------------------------------
+// HELPER: Milliseconds on the monotonic clock, truncated to 32 bits.
+static uint32_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000);
+}
+
+// -------------------------------------------------------------------
+// HELPER: Spread nearby keys (sequential IPs / user ids) over the table.
+static uint32_t mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// -------------------------------------------------------------------
+// HELPER: Refill key's bucket for the elapsed time and take one token.
+// Returns 1 if a token was available.
+static int bucket_take(struct bucket_table *table, uint32_t key)
+{
+    size_t stripe_size = table->slots / ADMISSION_STRIPES;
+    uint32_t h = mix32(key);
+    size_t stripe = h % ADMISSION_STRIPES;
+    size_t base = stripe * stripe_size;
+    size_t home = (h / ADMISSION_STRIPES) % stripe_size;
+    uint32_t now = now_ms();
+    int allowed;
+
+    pthread_mutex_lock(&table->locks[stripe]);
+
+    // 1) Find the key, or the slot to (re)use, within the probe window
+    struct bucket *slot = NULL;
+    struct bucket *oldest = NULL;
+    for (size_t i = 0; i < ADMISSION_PROBE; i++) {
+        struct bucket *b = &table->entries[base + (home + i) % stripe_size];
+        if (b->key == key || b->key == 0) {
+            slot = b;
+            break;
+        }
+        if (!oldest || (uint32_t)(now - b->stamp_ms) > (uint32_t)(now - oldest->stamp_ms)) {
+            oldest = b;
+        }
+    }
+    if (!slot || slot->key != key) {
+        slot = slot ? slot : oldest;
+        slot->key = key;
+        slot->stamp_ms = now;
+        slot->tokens = table->burst;
+    }
+
+    // 2) Refill, then spend
+    float refill = (uint32_t)(now - slot->stamp_ms) * table->rate / 1000.0f;
+    slot->tokens = slot->tokens + refill < table->burst ? slot->tokens + refill : table->burst;
+    slot->stamp_ms = now;
+    allowed = slot->tokens >= 1.0f;
+    if (allowed) {
+        slot->tokens -= 1.0f;
+    }
+
+    pthread_mutex_unlock(&table->locks[stripe]);
+    return allowed;
+}
+
+void admission_set_rate_limits(int enabled)
+{
+    g_rate_limits = enabled;
+}
+
+int admission_check_client(uint32_t ipv4)
+{
+    // 0.0.0.0 never connects, but keep 0 free as the empty-slot marker
+    if (g_rate_limits && !bucket_take(&g_ip_table, ipv4 ? ipv4 : 1)) {
+        atomic_fetch_add(&g_shed_ip, 1);
+        return 0;
+    }
+    atomic_fetch_add(&g_admitted, 1);
+    return 1;
+}
+
+int admission_check_session(int user_id)
+{
+    if (g_rate_limits && !bucket_take(&g_session_table, (uint32_t)user_id)) {
+        atomic_fetch_add(&g_shed_session, 1);
+        return 0;
+    }
+    return 1;
+}
+
+int admission_enter_expensive(void)
+{
+    if (atomic_fetch_add(&g_expensive_in_flight, 1) >= ADMISSION_MAX_EXPENSIVE) {
+        atomic_fetch_sub(&g_expensive_in_flight, 1);
+        atomic_fetch_add(&g_shed_busy, 1);
+        return 0;
+    }
+    return 1;
+}
+
+void admission_leave_expensive(void)
+{
+    atomic_fetch_sub(&g_expensive_in_flight, 1);
+}
+
+int admission_in_flight(void)
+{
+    return atomic_load(&g_expensive_in_flight);
+}
+
+void admission_reject(int socket_fd)
+{
+    static const char response[] =
+        "HTTP/1.1 429 Too Many Requests\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Retry-After: 1\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 18\r\n"
+        "Connection: close\r\n"
+        "\r\n"
+        "Too many requests\n";
+    char scratch[1024];
+
+    // Discard whatever request bytes already arrived: closing a socket with
+    // unread data resets the connection and the client may never see the 429.
+    for (int i = 0; i < 4 && recv(socket_fd, scratch, sizeof(scratch), MSG_DONTWAIT) > 0; i++) {
+    }
+
+    // One non-blocking send - a shed client never gets to stall the loop
+    send(socket_fd, response, sizeof(response) - 1, MSG_DONTWAIT);
+    close(socket_fd);
+}
+
+char *admission_metrics(void)
+{
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "# HELP requests_admitted_total Connections that passed the per-IP rate limit.\n"
+             "# TYPE requests_admitted_total counter\n"
+             "requests_admitted_total %llu\n"
+             "# HELP requests_shed_total Requests rejected with 429, by reason.\n"
+             "# TYPE requests_shed_total counter\n"
+             "requests_shed_total{reason=\"ip_rate\"} %llu\n"
+             "requests_shed_total{reason=\"session_rate\"} %llu\n"
+             "requests_shed_total{reason=\"concurrency\"} %llu\n"
+             "# HELP expensive_requests_in_flight Exports holding an expensive-route slot.\n"
+             "# TYPE expensive_requests_in_flight gauge\n"
+             "expensive_requests_in_flight %d\n",
+             (unsigned long long)atomic_load(&g_admitted),
+             (unsigned long long)atomic_load(&g_shed_ip),
+             (unsigned long long)atomic_load(&g_shed_session),
+             (unsigned long long)atomic_load(&g_shed_busy),
+             atomic_load(&g_expensive_in_flight));
+    return strdup(text);
+}
+
+int admission_snapshot_write(FILE *f)
+{
+    uint64_t counters[4] = {
+        atomic_load(&g_admitted), atomic_load(&g_shed_ip),
+        atomic_load(&g_shed_session), atomic_load(&g_shed_busy)
+    };
+    return fwrite(counters, sizeof(counters), 1, f) == 1 ? 0 : -1;
+}
+
+int admission_snapshot_read(FILE *f)
+{
+    uint64_t counters[4];
+    if (fread(counters, sizeof(counters), 1, f) != 1) {
+        return -1;
+    }
+    atomic_fetch_add(&g_admitted, counters[0]);
+    atomic_fetch_add(&g_shed_ip, counters[1]);
+    atomic_fetch_add(&g_shed_session, counters[2]);
+    atomic_fetch_add(&g_shed_busy, counters[3]);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Admission control for the accept loop: token buckets per client IP and
+// per logged-in session, plus a cap on concurrent expensive requests.
+// All functions are safe to call from any thread.
+
+// Turns the rate limits off (the expensive-route cap stays), e.g. for
+// benchmarks that drive the server from a single address.
+void admission_set_rate_limits(int enabled);
+
+// Takes a token from the bucket of an IPv4 address (network byte order).
+// Returns 1 to admit, 0 to shed.
+int admission_check_client(uint32_t ipv4);
+
+// Takes a token from the bucket of a logged-in user. Returns 1 or 0.
+int admission_check_session(int user_id);
+
+// Claims one of the expensive-route slots, for work that runs on its own
+// thread beside the accept loop (exports). Handlers that finish inside the
+// loop never overlap, so they do not take one. Returns 1 on success, 0 if
+// all slots are busy. Every successful call needs one admission_leave_expensive().
+int admission_enter_expensive(void);
+void admission_leave_expensive(void);
+
+// Number of expensive-route slots currently held (exports still streaming).
+int admission_in_flight(void);
+
+// Sends a canned 429 without waiting on the client and closes socket_fd.
+void admission_reject(int socket_fd);
+
+// GET /metrics: shed/admit counters in Prometheus text format (malloc'd).
+char *admission_metrics(void);
+
+// Carry the counters across a restart (see snapshot.h). Return 0 or -1.
+int admission_snapshot_write(FILE *f);
+int admission_snapshot_read(FILE *f);
+
+#endif
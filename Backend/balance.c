@@ -0,0 +1,696 @@
+/******************************************************************************
+ * balance.c
+ *
+ * GET /reports/range: income, expense and running balance for any date
+ * range, answered from two Fenwick (binary indexed) trees per user - one
+ * for income cents and one for expense cents, indexed by day number.
+ *
+ *   - Built lazily on a user's first range query from one grouped scan
+ *     of their rows, then kept current by balance_record() on each insert.
+ *   - A range total is two prefix sums, O(log days) whatever the number
+ *     of transactions.
+ *   - The tree covers [base_day, base_day + size); a date outside the span
+ *     regrows it to the next power of two that fits, up to
+ *     BALANCE_MAX_SPAN days. Days beyond that (a typo such as 0001-01-01)
+ *     are kept as a short sorted list of outliers and summed directly, so
+ *     one odd date cannot blow a tree up to millions of positions.
+ *   - At most BALANCE_MAX_USERS indexes and BALANCE_MAX_POSITIONS tree
+ *     positions in total are kept; the least recently used indexes are
+ *     dropped to make room.
+ *   - Recurring rules stay out of the trees: the index keeps the user's
+ *     rules and adds amount x occurrences due in the range, counted in
+ *     closed form per rule, so a new day needs no rebuild and a daily rule
+ *     costs the same as a yearly one.
+ ******************************************************************************/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sqlite3.h>
+
+#include "balance.h"
+#include "dates.h"
+#include "http.h"
+#include "recurring.h"
+#include "shard.h"
+#include "storage.h"
+#include "txlog.h"
+
+#define BALANCE_MAX_USERS     1024
+#define BALANCE_MIN_SIZE      512         // days; grows in powers of two
+#define BALANCE_MAX_SPAN      8192        // days (~22 years), 128KB of trees
+#define BALANCE_FUTURE_DAYS   1024        // kept ahead of today by a capped span
+#define BALANCE_MAX_POSITIONS (1 << 22)   // all users together, 64MB of trees
+#define BALANCE_READ_BATCH    256
+
+// A day outside the indexed span
+struct balance_outlier {
+    int day;
+    int64_t income_cents;
+    int64_t expense_cents;
+};
+
+struct balance_user {
+    int user_id;                // 0 = empty slot
+    int base_day;               // day stored at Fenwick position 1
+    int size;                   // positions, a power of two
+    int64_t *income;            // Fenwick trees, 1-based, size + 1 entries
+    int64_t *expense;
+    struct balance_outlier *outliers;   // sorted by day
+    int outlier_count;
+    int outlier_cap;
+    struct recurring_rule *rules;       // counted at query time, see sum_through
+    int rule_count;
+    int rules_loaded;           // 0 after a snapshot read until the first query
+    unsigned long last_used;
+};
+
+// One aggregated (day, type) row while building
+struct balance_point {
+    int day;
+    int is_income;
+    int64_t cents;
+};
+
+static struct balance_user g_users[BALANCE_MAX_USERS];
+static unsigned long g_clock = 0;
+static long g_positions = 0;            // sum of size over built indexes
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// -------------------------------------------------------------------
+// Fenwick tree primitives (positions 1..size)
+// -------------------------------------------------------------------
+static void fenwick_add(int64_t *tree, int size, int pos, int64_t delta)
+{
+    for (; pos <= size; pos += pos & -pos) {
+        tree[pos] += delta;
+    }
+}
+
+static int64_t fenwick_prefix(const int64_t *tree, int pos)
+{
+    int64_t sum = 0;
+    for (; pos > 0; pos -= pos & -pos) {
+        sum += tree[pos];
+    }
+    return sum;
+}
+
+// Turns an array of point values into a Fenwick tree in O(size).
+static void fenwick_build(int64_t *tree, int size)
+{
+    for (int i = 1; i <= size; i++) {
+        int parent = i + (i & -i);
+        if (parent <= size) {
+            tree[parent] += tree[i];
+        }
+    }
+}
+
+// Inverse of fenwick_build: back to point values in O(size).
+static void fenwick_unbuild(int64_t *tree, int size)
+{
+    for (int i = size; i >= 1; i--) {
+        int parent = i + (i & -i);
+        if (parent <= size) {
+            tree[parent] -= tree[i];
+        }
+    }
+}
+
+static int span_size(int days)
+{
+    int size = BALANCE_MIN_SIZE;
+    while (size < days && size < BALANCE_MAX_SPAN) {
+        size *= 2;
+    }
+    return size;
+}
+
+static void free_user(struct balance_user *u)
+{
+    g_positions -= u->size;
+    free(u->income);
+    free(u->expense);
+    free(u->outliers);
+    recurring_free(u->rules, u->rule_count);
+    memset(u, 0, sizeof(*u));
+}
+
+// Adds cents to the outlier entry for day, inserting it in order.
+static int outlier_add(struct balance_user *u, int day, int is_income, int64_t cents)
+{
+    int lo = 0, hi = u->outlier_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (u->outliers[mid].day < day) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == u->outlier_count || u->outliers[lo].day != day) {
+        if (u->outlier_count == u->outlier_cap) {
+            int cap = u->outlier_cap ? u->outlier_cap * 2 : 8;
+            struct balance_outlier *grown = realloc(u->outliers, (size_t)cap * sizeof(*grown));
+            if (!grown) {
+                return -1;
+            }
+            u->outliers = grown;
+            u->outlier_cap = cap;
+        }
+        memmove(&u->outliers[lo + 1], &u->outliers[lo],
+                (size_t)(u->outlier_count - lo) * sizeof(*u->outliers));
+        u->outliers[lo] = (struct balance_outlier){ day, 0, 0 };
+        u->outlier_count++;
+    }
+    if (is_income) {
+        u->outliers[lo].income_cents += cents;
+    } else {
+        u->outliers[lo].expense_cents += cents;
+    }
+    return 0;
+}
+
+// Drops least recently used indexes other than keep until `extra` more
+// positions fit in BALANCE_MAX_POSITIONS.
+static void make_room(long extra, const struct balance_user *keep)
+{
+    while (g_positions + extra > BALANCE_MAX_POSITIONS) {
+        struct balance_user *victim = NULL;
+        for (int i = 0; i < BALANCE_MAX_USERS; i++) {
+            if (g_users[i].user_id != 0 && &g_users[i] != keep &&
+                (!victim || g_users[i].last_used < victim->last_used)) {
+                victim = &g_users[i];
+            }
+        }
+        if (!victim) {
+            return;
+        }
+        free_user(victim);
+    }
+}
+
+// (Re)creates u's trees over [base_day, base_day + size) from points;
+// points outside the span become outliers.
+static int fill_user(struct balance_user *u, int base_day, int size,
+                     const struct balance_point *points, size_t count)
+{
+    make_room(size - u->size, u);
+    int64_t *income = calloc((size_t)size + 1, sizeof(int64_t));
+    int64_t *expense = calloc((size_t)size + 1, sizeof(int64_t));
+    if (!income || !expense) {
+        free(income);
+        free(expense);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int pos = points[i].day - base_day + 1;
+        if (pos < 1 || pos > size) {
+            if (points[i].cents && outlier_add(u, points[i].day, points[i].is_income, points[i].cents) < 0) {
+                free(income);
+                free(expense);
+                return -1;
+            }
+        } else if (points[i].is_income) {
+            income[pos] += points[i].cents;
+        } else {
+            expense[pos] += points[i].cents;
+        }
+    }
+    fenwick_build(income, size);
+    fenwick_build(expense, size);
+
+    free(u->income);
+    free(u->expense);
+    g_positions += size - u->size;
+    u->income = income;
+    u->expense = expense;
+    u->base_day = base_day;
+    u->size = size;
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Loading a user's per-day totals from whichever engine is active
+// -------------------------------------------------------------------
+static int push_point(struct balance_point **points, size_t *count, size_t *cap,
+                      int day, int is_income, int64_t cents)
+{
+    if (*count == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 256;
+        struct balance_point *grown = realloc(*points, new_cap * sizeof(*grown));
+        if (!grown) {
+            return -1;
+        }
+        *points = grown;
+        *cap = new_cap;
+    }
+    (*points)[*count].day = day;
+    (*points)[*count].is_income = is_income;
+    (*points)[*count].cents = cents;
+    (*count)++;
+    return 0;
+}
+
+static int load_points_sqlite(int user_id, struct balance_point **points, size_t *count, size_t *cap)
+{
+    sqlite3_stmt *stmt;
+    int rc = 0;
+
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        return -1;
+    }
+
+    // One row per (date, type): the index only needs daily sums
+    const char *sql =
+        "SELECT date, trans_type = 'income', SUM(amount) "
+        "FROM transactions "
+        "WHERE user_id = ? AND trans_type IN ('income', 'expense') "
+        "GROUP BY date, trans_type;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement (balance): %s\n", sqlite3_errmsg(db));
+        shard_release(user_id);
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char *date = sqlite3_column_text(stmt, 0);
+        int day;
+        if (!date || !date_to_day((const char *)date, &day)) {
+            continue;
+        }
+        if (push_point(points, count, cap, day, sqlite3_column_int(stmt, 1),
+                       llround(sqlite3_column_double(stmt, 2) * 100.0)) < 0) {
+            rc = -1;
+            break;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    shard_release(user_id);
+    return rc;
+}
+
+static int load_points_txlog(int user_id, struct balance_point **points, size_t *count, size_t *cap)
+{
+    struct txlog_record batch[BALANCE_READ_BATCH];
+    struct txlog_cursor cursor = {0};
+    size_t n;
+
+    while ((n = txlog_read_user(user_id, &cursor, 0, batch, BALANCE_READ_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            int is_income = strcmp(batch[i].trans_type, "income") == 0;
+            if (batch[i].day == TXLOG_NO_DAY || (!is_income && strcmp(batch[i].trans_type, "expense") != 0)) {
+                continue;
+            }
+            if (push_point(points, count, cap, batch[i].day, is_income, batch[i].amount_cents) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Index lookup / build (called with g_lock held)
+// -------------------------------------------------------------------
+static struct balance_user *find_user(int user_id)
+{
+    for (int i = 0; i < BALANCE_MAX_USERS; i++) {
+        if (g_users[i].user_id == user_id) {
+            g_users[i].last_used = ++g_clock;
+            return &g_users[i];
+        }
+    }
+    return NULL;
+}
+
+// Empty slot, or the least recently used index freed to make room.
+static struct balance_user *claim_slot(void)
+{
+    struct balance_user *slot = NULL;
+    for (int i = 0; i < BALANCE_MAX_USERS; i++) {
+        if (g_users[i].user_id == 0) {
+            slot = &g_users[i];
+            break;
+        }
+        if (!slot || g_users[i].last_used < slot->last_used) {
+            slot = &g_users[i];
+        }
+    }
+    free_user(slot);
+    return slot;
+}
+
+static struct balance_user *build_user(int user_id)
+{
+    struct balance_point *points = NULL;
+    size_t count = 0, cap = 0;
+    int today = recurring_today();
+
+    // 1) Daily totals from storage
+    int rc = storage_get_engine() == STORAGE_TXLOG
+        ? load_points_txlog(user_id, &points, &count, &cap)
+        : load_points_sqlite(user_id, &points, &count, &cap);
+    if (rc < 0) {
+        free(points);
+        return NULL;
+    }
+
+    // 2) Span covering every dated row, with room to grow forwards
+    int min_day = today, max_day = min_day;
+    for (size_t i = 0; i < count; i++) {
+        if (points[i].day < min_day) min_day = points[i].day;
+        if (points[i].day > max_day) max_day = points[i].day;
+    }
+
+    // 3) A span too wide for one tree keeps the years up to today indexed;
+    //    rows further out become outliers
+    int base_day = min_day;
+    int needed = max_day - min_day + 1 + BALANCE_MIN_SIZE / 2;
+    int size = span_size(needed);
+    if (size < needed && base_day < today + BALANCE_FUTURE_DAYS - size) {
+        base_day = today + BALANCE_FUTURE_DAYS - size;
+    }
+
+    // 4) Reuse an empty slot, or evict the least recently used index
+    struct balance_user *slot = claim_slot();
+    if (fill_user(slot, base_day, size, points, count) < 0) {
+        free_user(slot);
+        free(points);
+        return NULL;
+    }
+    free(points);
+
+    slot->user_id = user_id;
+    slot->last_used = ++g_clock;
+    return slot;
+}
+
+// Regrows u so that day falls inside its span. Returns 1 if the span
+// cannot grow that far (the day is kept as an outlier), -1 on error.
+static int cover_day(struct balance_user *u, int day)
+{
+    if (day >= u->base_day && day < u->base_day + u->size) {
+        return 0;
+    }
+
+    int new_base = day < u->base_day ? day : u->base_day;
+    int old_end = u->base_day + u->size;
+    int new_end = day >= old_end ? day + 1 : old_end;
+    int new_size = span_size(new_end - new_base);
+    if (new_size < new_end - new_base) {
+        return 1;
+    }
+
+    // Recover each day's value from the old trees, then rebuild
+    struct balance_point *points = malloc((size_t)u->size * 2 * sizeof(*points));
+    if (!points) {
+        return -1;
+    }
+    fenwick_unbuild(u->income, u->size);
+    fenwick_unbuild(u->expense, u->size);
+    size_t count = 0;
+    for (int pos = 1; pos <= u->size; pos++) {
+        if (u->income[pos]) {
+            points[count++] = (struct balance_point){ u->base_day + pos - 1, 1, u->income[pos] };
+        }
+        if (u->expense[pos]) {
+            points[count++] = (struct balance_point){ u->base_day + pos - 1, 0, u->expense[pos] };
+        }
+    }
+    int rc = fill_user(u, new_base, new_size, points, count);
+    free(points);
+    return rc;
+}
+
+// Income or expense total up to and including day: the tree clamped to
+// its span, the outliers, and each rule's occurrences up to day or today.
+static int64_t sum_through(const struct balance_user *u, int is_income, int day, int today)
+{
+    const int64_t *tree = is_income ? u->income : u->expense;
+    int64_t sum = 0;
+    int pos = day - u->base_day + 1;
+    if (pos > 0) {
+        sum = fenwick_prefix(tree, pos > u->size ? u->size : pos);
+    }
+    for (int i = 0; i < u->outlier_count && u->outliers[i].day <= day; i++) {
+        sum += is_income ? u->outliers[i].income_cents : u->outliers[i].expense_cents;
+    }
+    int due = day < today ? day : today;
+    for (int i = 0; i < u->rule_count; i++) {
+        const struct recurring_rule *rule = &u->rules[i];
+        if (rule->is_income == is_income) {
+            sum += llround(rule->amount * 100.0) *
+                   (int64_t)recurring_count_between(rule, rule->start_day, due);
+        }
+    }
+    return sum;
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+int balance_range(int user_id, int from_day, int to_day, struct balance_totals *out)
+{
+    pthread_mutex_lock(&g_lock);
+    struct balance_user *u = find_user(user_id);
+    if (!u) {
+        u = build_user(user_id);
+    }
+    if (u && !u->rules_loaded) {
+        u->rule_count = recurring_load(user_id, &u->rules);
+        if (u->rule_count < 0) {
+            free_user(u);
+            u = NULL;
+        } else {
+            u->rules_loaded = 1;
+        }
+    }
+    if (!u) {
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    int today = recurring_today();
+    out->income_cents = sum_through(u, 1, to_day, today) - sum_through(u, 1, from_day - 1, today);
+    out->expense_cents = sum_through(u, 0, to_day, today) - sum_through(u, 0, from_day - 1, today);
+    out->balance_cents = sum_through(u, 1, to_day, today) - sum_through(u, 0, to_day, today);
+    if (from_day > to_day) {
+        out->income_cents = 0;
+        out->expense_cents = 0;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+void balance_record(int user_id, const char *type, const char *amount, const char *date)
+{
+    int is_income = strcmp(type, "income") == 0;
+    int day;
+    if ((!is_income && strcmp(type, "expense") != 0) || !date_to_day(date, &day)) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    struct balance_user *u = find_user(user_id);
+    if (u) {
+        int64_t cents = llround(strtod(amount, NULL) * 100.0);
+        int rc = cover_day(u, day);
+        if (rc == 0) {
+            fenwick_add(is_income ? u->income : u->expense, u->size, day - u->base_day + 1, cents);
+        } else if (rc < 0 || outlier_add(u, day, is_income, cents) < 0) {
+            free_user(u);       // rebuilt from storage on the next query
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+void balance_invalidate(int user_id)
+{
+    pthread_mutex_lock(&g_lock);
+    struct balance_user *u = find_user(user_id);
+    if (u) {
+        free_user(u);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// -------------------------------------------------------------------
+// Snapshot: per user a header, then one record per day with activity
+// -------------------------------------------------------------------
+struct balance_snapshot_user {
+    int32_t user_id;
+    int32_t base_day;
+    int32_t size;
+    uint32_t days;
+};
+
+struct balance_snapshot_day {
+    int32_t day;
+    int32_t pad;
+    int64_t income_cents;
+    int64_t expense_cents;
+};
+
+int balance_snapshot_write(FILE *f)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&g_lock);
+
+    // 1) Least recently used first: reading back in file order then
+    //    leaves the hottest users with the newest stamps
+    struct balance_user *order[BALANCE_MAX_USERS];
+    uint32_t users = 0;
+    for (int i = 0; i < BALANCE_MAX_USERS; i++) {
+        if (g_users[i].user_id == 0) {
+            continue;
+        }
+        uint32_t j = users++;
+        while (j > 0 && order[j - 1]->last_used > g_users[i].last_used) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = &g_users[i];
+    }
+    if (fwrite(&users, sizeof(users), 1, f) != 1) {
+        rc = -1;
+    }
+
+    // 2) Each tree back to its non-zero days, then the outliers
+    for (uint32_t i = 0; i < users && rc == 0; i++) {
+        const struct balance_user *u = order[i];
+        struct balance_snapshot_user header = { u->user_id, u->base_day, u->size, 0 };
+        for (int pos = 1; pos <= u->size; pos++) {
+            if (fenwick_prefix(u->income, pos) != fenwick_prefix(u->income, pos - 1) ||
+                fenwick_prefix(u->expense, pos) != fenwick_prefix(u->expense, pos - 1)) {
+                header.days++;
+            }
+        }
+        header.days += (uint32_t)u->outlier_count;
+        if (fwrite(&header, sizeof(header), 1, f) != 1) {
+            rc = -1;
+            break;
+        }
+        for (int pos = 1; pos <= u->size; pos++) {
+            struct balance_snapshot_day day = {
+                u->base_day + pos - 1, 0,
+                fenwick_prefix(u->income, pos) - fenwick_prefix(u->income, pos - 1),
+                fenwick_prefix(u->expense, pos) - fenwick_prefix(u->expense, pos - 1)
+            };
+            if ((day.income_cents || day.expense_cents) && fwrite(&day, sizeof(day), 1, f) != 1) {
+                rc = -1;
+                break;
+            }
+        }
+        for (int o = 0; o < u->outlier_count && rc == 0; o++) {
+            struct balance_snapshot_day day = {
+                u->outliers[o].day, 0, u->outliers[o].income_cents, u->outliers[o].expense_cents
+            };
+            if (fwrite(&day, sizeof(day), 1, f) != 1) {
+                rc = -1;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+int balance_snapshot_read(FILE *f)
+{
+    uint32_t users;
+    int loaded = 0;
+
+    if (fread(&users, sizeof(users), 1, f) != 1) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < users; i++) {
+        // 1) Read one user completely before touching the table
+        struct balance_snapshot_user header;
+        if (fread(&header, sizeof(header), 1, f) != 1 || header.user_id == 0 ||
+            header.size < BALANCE_MIN_SIZE || header.size > BALANCE_MAX_SPAN ||
+            (header.size & (header.size - 1)) != 0 || header.days > BALANCE_MAX_POSITIONS) {
+            return -1;
+        }
+        struct balance_point *points = malloc(((size_t)header.days * 2 + 1) * sizeof(*points));
+        if (!points) {
+            return -1;
+        }
+        size_t count = 0;
+        for (uint32_t d = 0; d < header.days; d++) {
+            struct balance_snapshot_day day;
+            if (fread(&day, sizeof(day), 1, f) != 1) {
+                free(points);
+                return -1;
+            }
+            points[count++] = (struct balance_point){ day.day, 1, day.income_cents };
+            points[count++] = (struct balance_point){ day.day, 0, day.expense_cents };
+        }
+
+        // 2) Install it like a freshly built index
+        pthread_mutex_lock(&g_lock);
+        if (!find_user(header.user_id)) {
+            struct balance_user *slot = claim_slot();
+            if (fill_user(slot, header.base_day, header.size, points, count) == 0) {
+                slot->user_id = header.user_id;
+                slot->last_used = ++g_clock;
+                loaded++;
+            } else {
+                free_user(slot);
+            }
+        }
+        pthread_mutex_unlock(&g_lock);
+        free(points);
+    }
+    return loaded;
+}
+
+char *handle_range_report_request(int user_id, const char *query, int *bad_request)
+{
+    char from[16] = "";
+    char to[16] = "";
+    int from_day = INT32_MIN / 2;                 // no lower bound
+    int to_day = (int)(time(NULL) / 86400);       // up to today
+
+    // 1) Parse the optional bounds
+    *bad_request = 0;
+    if ((http_query_param(query, "from", from, sizeof(from)) && from[0] &&
+         (!http_is_date(from) || !date_to_day(from, &from_day))) ||
+        (http_query_param(query, "to", to, sizeof(to)) && to[0] &&
+         (!http_is_date(to) || !date_to_day(to, &to_day)))) {
+        *bad_request = 1;
+        return strdup("{\"error\":\"from/to must be YYYY-MM-DD\"}");
+    }
+
+    // 2) Two prefix sums per tree
+    struct balance_totals totals;
+    if (balance_range(user_id, from_day, to_day, &totals) < 0) {
+        return strdup("{\"error\":\"Cannot load transactions\"}");
+    }
+
+    // 3) Echo the effective range back with the totals
+    char to_str[16];
+    day_to_date(to_day, to_str, sizeof(to_str));
+
+    char json[512];
+    snprintf(json, sizeof(json),
+             "{\"from\":%s%s%s,\"to\":\"%s\",\"income\":%.2f,\"expense\":%.2f,\"net\":%.2f,\"balance\":%.2f}",
+             from[0] ? "\"" : "", from[0] ? from : "null", from[0] ? "\"" : "",
+             to_str,
+             totals.income_cents / 100.0,
+             totals.expense_cents / 100.0,
+             (totals.income_cents - totals.expense_cents) / 100.0,
+             totals.balance_cents / 100.0);
+    return strdup(json);
+}
@@ -0,0 +1,36 @@
+#ifndef BALANCE_H
+#define BALANCE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Per-user prefix-sum index over day numbers (see dates.h). Answers
+// income/expense totals for any date range in O(log n) once built.
+
+struct balance_totals {
+    int64_t income_cents;     // income within [from_day, to_day]
+    int64_t expense_cents;    // expenses within [from_day, to_day]
+    int64_t balance_cents;    // all income minus all expenses up to to_day
+};
+
+// Totals for user_id between from_day and to_day inclusive. Builds the
+// user's index from storage on first use. Returns 0 on success, -1 on error.
+int balance_range(int user_id, int from_day, int to_day, struct balance_totals *out);
+
+// Keeps a built index in step with a committed insert (no-op otherwise).
+void balance_record(int user_id, const char *type, const char *amount, const char *date);
+
+// Drops the user's index; it is rebuilt lazily on the next query.
+void balance_invalidate(int user_id);
+
+// Writes every built index as sparse per-day totals and reads them back,
+// e.g. into the process taking over after a restart (see snapshot.h).
+// write returns 0 or -1; read returns the number of users loaded or -1.
+int balance_snapshot_write(FILE *f);
+int balance_snapshot_read(FILE *f);
+
+// GET /reports/range?from=YYYY-MM-DD&to=YYYY-MM-DD
+// Returns a malloc'd JSON body. *bad_request is set to 1 for invalid dates.
+char *handle_range_report_request(int user_id, const char *query, int *bad_request);
+
+#endif
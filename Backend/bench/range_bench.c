@@ -0,0 +1,184 @@
+/******************************************************************************
+ * range_bench.c
+ *
+ * Date-range totals: the Fenwick index behind /reports/range versus the
+ * equivalent SQL SUM over the (user_id, date) index. Both answer the same
+ * random ranges and the results are cross-checked, then once more over
+ * every date after rows far outside the indexed span are added.
+ *
+ * Build & run from Backend/:
+ *   gcc -O2 -I. -o range_bench bench/range_bench.c balance.c shard.c storage.c \
+ *       txlog.c dates.c recurring.c transactions.c \
+ *       events.c http.c -lsqlite3 -lpthread -lm
+ *   ./range_bench [rows] [queries]
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sqlite3.h>
+
+#include "balance.h"
+#include "dates.h"
+#include "shard.h"
+
+#define USER_ID   1
+#define SPAN_DAYS 3650
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 200000;
+    int queries = argc > 2 ? atoi(argv[2]) : 2000;
+    if (rows < 1 || queries < 1) {
+        fprintf(stderr, "Usage: %s [rows] [queries]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // 1) Scratch database with `rows` transactions over ten years
+    char dir[] = "/tmp/range_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0 || shard_init(1) < 0) {
+        return EXIT_FAILURE;
+    }
+    int first_day;
+    date_to_day("2015-01-01", &first_day);
+
+    sqlite3 *db = shard_acquire(USER_ID);
+    sqlite3_stmt *insert;
+    sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+    sqlite3_prepare_v2(db,
+        "INSERT INTO transactions (user_id, trans_type, amount, date, category) VALUES (?, ?, ?, ?, 'Bench');",
+        -1, &insert, NULL);
+    srand(42);
+    for (int i = 0; i < rows; i++) {
+        char date[16];
+        day_to_date(first_day + rand() % SPAN_DAYS, date, sizeof(date));
+        sqlite3_bind_int(insert, 1, USER_ID);
+        sqlite3_bind_text(insert, 2, (i % 4 == 0) ? "income" : "expense", -1, SQLITE_STATIC);
+        sqlite3_bind_double(insert, 3, (rand() % 100000) / 100.0);
+        sqlite3_bind_text(insert, 4, date, -1, SQLITE_TRANSIENT);
+        sqlite3_step(insert);
+        sqlite3_reset(insert);
+    }
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    shard_release(USER_ID);
+
+    // 2) Random ranges, shared by both methods
+    int *from = malloc(sizeof(int) * queries);
+    int *to = malloc(sizeof(int) * queries);
+    for (int q = 0; q < queries; q++) {
+        int a = first_day + rand() % SPAN_DAYS;
+        int b = first_day + rand() % SPAN_DAYS;
+        from[q] = a < b ? a : b;
+        to[q] = a < b ? b : a;
+    }
+
+    // 3) Fenwick index (first query pays for the build)
+    struct balance_totals totals;
+    double t0 = now_seconds();
+    balance_range(USER_ID, from[0], to[0], &totals);
+    double build_secs = now_seconds() - t0;
+
+    int64_t *index_net = malloc(sizeof(int64_t) * queries);
+    t0 = now_seconds();
+    for (int q = 0; q < queries; q++) {
+        balance_range(USER_ID, from[q], to[q], &totals);
+        index_net[q] = totals.income_cents - totals.expense_cents;
+    }
+    double index_secs = now_seconds() - t0;
+
+    // 4) SQL SUM over the same ranges
+    sqlite3_stmt *sum;
+    db = shard_acquire(USER_ID);
+    sqlite3_prepare_v2(db,
+        "SELECT TOTAL(CASE WHEN trans_type = 'income' THEN amount ELSE -amount END) "
+        "FROM transactions WHERE user_id = ? AND date BETWEEN ? AND ?;",
+        -1, &sum, NULL);
+    int mismatches = 0;
+    t0 = now_seconds();
+    for (int q = 0; q < queries; q++) {
+        char a[16], b[16];
+        day_to_date(from[q], a, sizeof(a));
+        day_to_date(to[q], b, sizeof(b));
+        sqlite3_bind_int(sum, 1, USER_ID);
+        sqlite3_bind_text(sum, 2, a, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(sum, 3, b, -1, SQLITE_TRANSIENT);
+        sqlite3_step(sum);
+        if (llround(sqlite3_column_double(sum, 0) * 100.0) != index_net[q]) {
+            mismatches++;
+        }
+        sqlite3_reset(sum);
+    }
+    double sql_secs = now_seconds() - t0;
+
+    // 5) Far-off dates: kept beside the tree, not by growing it
+    static const char *const far_rows[][3] = {
+        { "income", "0001-01-01", "11.00" }, { "expense", "9999-12-31", "22.00" },
+        { "expense", "1900-06-15", "33.00" }, { "income", "0500-01-01", "44.00" }
+    };
+    sqlite3_stmt *far;
+    sqlite3_prepare_v2(db,
+        "INSERT INTO transactions (user_id, trans_type, amount, date, category) VALUES (?, ?, ?, ?, 'Far');",
+        -1, &far, NULL);
+    for (int i = 0; i < 4; i++) {
+        sqlite3_bind_int(far, 1, USER_ID);
+        sqlite3_bind_text(far, 2, far_rows[i][0], -1, SQLITE_STATIC);
+        sqlite3_bind_text(far, 3, far_rows[i][2], -1, SQLITE_STATIC);
+        sqlite3_bind_text(far, 4, far_rows[i][1], -1, SQLITE_STATIC);
+        sqlite3_step(far);
+        sqlite3_reset(far);
+    }
+    sqlite3_finalize(far);
+    shard_release(USER_ID);
+
+    int last_day;
+    date_to_day("9999-12-31", &last_day);
+    for (int pass = 0; pass < 2; pass++) {
+        // pass 0: rows recorded into the built index; pass 1: rebuilt from storage
+        if (pass == 0) {
+            for (int i = 0; i < 4; i++) {
+                balance_record(USER_ID, far_rows[i][0], far_rows[i][2], far_rows[i][1]);
+            }
+        } else {
+            balance_invalidate(USER_ID);
+        }
+        balance_range(USER_ID, INT32_MIN / 2, last_day, &totals);
+        db = shard_acquire(USER_ID);
+        sqlite3_bind_int(sum, 1, USER_ID);
+        sqlite3_bind_text(sum, 2, "0000-01-01", -1, SQLITE_STATIC);
+        sqlite3_bind_text(sum, 3, "9999-12-31", -1, SQLITE_STATIC);
+        sqlite3_step(sum);
+        if (llround(sqlite3_column_double(sum, 0) * 100.0) != totals.income_cents - totals.expense_cents) {
+            mismatches++;
+        }
+        sqlite3_reset(sum);
+        shard_release(USER_ID);
+    }
+    sqlite3_finalize(sum);
+
+    printf("%d rows, %d random ranges\n", rows, queries);
+    printf("  index build      %10.2f ms (once per user)\n", build_secs * 1e3);
+    printf("  fenwick index    %10.2f us/query\n", index_secs * 1e6 / queries);
+    printf("  SQL SUM          %10.2f us/query\n", sql_secs * 1e6 / queries);
+    printf("  mismatches       %10d (incl. 2 all-dates checks with far-off rows)\n", mismatches);
+
+    shard_close();
+    free(from);
+    free(to);
+    free(index_net);
+
+    char cleanup[128];
+    snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dir);
+    system(cleanup);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * recurring_bench.c
+ *
+ * Recurring rules counted lazily versus the same occurrences stored as
+ * real rows. User 1 gets random rules (some occurrences edited or
+ * deleted); user 2 gets one transaction row per live occurrence of those
+ * rules plus user 1's edited rows. The edits start on freshly opened
+ * shards, so the first one reserves a new id block. Monthly totals and
+ * random range totals must then agree between the two users, and both
+ * are timed.
+ *
+ * Build & run from Backend/:
+ *   gcc -O2 -I. -o recurring_bench bench/recurring_bench.c balance.c shard.c \
+ *       storage.c txlog.c dates.c recurring.c transactions.c \
+ *       events.c http.c -lsqlite3 -lpthread -lm
+ *   ./recurring_bench [rules] [queries]
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sqlite3.h>
+
+#include "balance.h"
+#include "dates.h"
+#include "recurring.h"
+#include "shard.h"
+#include "transactions.h"
+
+#define LAZY_USER 1
+#define REAL_USER 2
+#define SPAN_DAYS 3650
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Inserts one row per occurrence visited
+static void insert_occurrence(const struct recurring_rule *rule, int day, void *ctx)
+{
+    sqlite3_stmt *insert = ctx;
+    char date[16];
+    day_to_date(day, date, sizeof(date));
+    sqlite3_bind_int(insert, 1, REAL_USER);
+    sqlite3_bind_text(insert, 2, rule->trans_type, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(insert, 3, rule->amount);
+    sqlite3_bind_text(insert, 4, date, -1, SQLITE_TRANSIENT);
+    sqlite3_step(insert);
+    sqlite3_reset(insert);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const units[] = { "day", "week", "month", "year" };
+    int rule_count = argc > 1 ? atoi(argv[1]) : 200;
+    int queries = argc > 2 ? atoi(argv[2]) : 2000;
+    if (rule_count < 1 || queries < 1) {
+        fprintf(stderr, "Usage: %s [rules] [queries]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char dir[] = "/tmp/recurring_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0 || shard_init(1) < 0) {
+        return EXIT_FAILURE;
+    }
+    int today = recurring_today();
+    int first_day = today - SPAN_DAYS;
+
+    // 1) Random rules over the last ten years, a third of them ending
+    srand(42);
+    for (int i = 0; i < rule_count; i++) {
+        char start[16], end[16] = "", request[512], *reply;
+        int bad;
+        int start_day = first_day + rand() % SPAN_DAYS;
+        day_to_date(start_day, start, sizeof(start));
+        if (i % 3 == 0) {
+            day_to_date(start_day + rand() % SPAN_DAYS, end, sizeof(end));
+        }
+        snprintf(request, sizeof(request),
+                 "POST /recurring HTTP/1.1\r\n\r\n"
+                 "{\"type\":\"%s\",\"amount\":\"%d.%02d\",\"category\":\"Bench\",\"start\":\"%s\","
+                 "\"unit\":\"%s\",\"every\":\"%d\",\"end\":\"%s\"}",
+                 i % 4 == 0 ? "income" : "expense", 1 + rand() % 2000, rand() % 100,
+                 start, units[rand() % 4], 1 + rand() % 3, end);
+        reply = handle_create_recurring_request(request, LAZY_USER, &bad);
+        if (bad || strstr(reply, "error")) {
+            fprintf(stderr, "rule %d: %s\n", i, reply);
+            return EXIT_FAILURE;
+        }
+        free(reply);
+    }
+
+    // 2) Edit or delete some occurrences. The shards
+    //    are reopened first, as after a restart, so the first edit has to
+    //    reserve a fresh id block while it runs
+    shard_close();
+    if (shard_init(1) < 0) {
+        return EXIT_FAILURE;
+    }
+    struct recurring_rule *rules;
+    int count = recurring_load(LAZY_USER, &rules);
+    int edits = 0, attempts = 0;
+    for (int i = 0; i < count; i++) {
+        // Every fifth rule: an early occurrence, edited or deleted. Every
+        // seventh: its latest one, so a month may fall back a year
+        int due = recurring_count_through(&rules[i], today);
+        int n = i % 5 == 0 ? 1 : i % 7 == 3 ? due - 1 : -1;
+        if (n < 1 || due < 2) {
+            continue;
+        }
+        attempts++;
+        char date[16], request[512], *reply;
+        int bad;
+        day_to_date(recurring_occurrence_day(&rules[i], n), date, sizeof(date));
+        snprintf(request, sizeof(request),
+                 "POST /recurring/occurrence HTTP/1.1\r\n\r\n{\"rule_id\":\"%d\",\"date\":\"%s\",%s}",
+                 rules[i].id, date, i % 2 ? "\"delete\":\"true\"" : "\"amount\":\"7.25\"");
+        reply = handle_edit_occurrence_request(request, LAZY_USER, &bad);
+        edits += !bad && !strstr(reply, "error");
+        free(reply);
+    }
+    recurring_free(rules, count);
+    if (edits != attempts) {
+        fprintf(stderr, "%d of %d occurrence edits failed\n", attempts - edits, attempts);
+        return EXIT_FAILURE;
+    }
+
+    // 3) The same data as rows: live occurrences plus the edited rows
+    double t0 = now_seconds();
+    count = recurring_load(LAZY_USER, &rules);
+    sqlite3 *db = shard_acquire(REAL_USER);
+    sqlite3_stmt *insert;
+    sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+    sqlite3_prepare_v2(db,
+        "INSERT INTO transactions (user_id, trans_type, amount, date, category) VALUES (?, ?, ?, ?, 'Bench');",
+        -1, &insert, NULL);
+    for (int i = 0; i < count; i++) {
+        recurring_for_each(&rules[i], rules[i].start_day, today, insert_occurrence, insert);
+    }
+    sqlite3_finalize(insert);
+    sqlite3_exec(db,
+        "INSERT INTO transactions (user_id, trans_type, amount, date, category) "
+        "SELECT 2, trans_type, amount, date, category FROM transactions WHERE user_id = 1;"
+        "COMMIT;", NULL, NULL, NULL);
+    sqlite3_stmt *rows_stmt;
+    sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM transactions WHERE user_id = 2;", -1, &rows_stmt, NULL);
+    sqlite3_step(rows_stmt);
+    int rows = sqlite3_column_int(rows_stmt, 0);
+    sqlite3_finalize(rows_stmt);
+    shard_release(REAL_USER);
+    recurring_free(rules, count);
+    double materialise_secs = now_seconds() - t0;
+
+    // 4) Monthly totals: 12 buckets each way
+    int mismatches = 0;
+    double lazy_exp[12] = { 0 }, lazy_inc[12] = { 0 }, real_exp[12] = { 0 }, real_inc[12] = { 0 };
+    t0 = now_seconds();
+    get_monthly_totals(LAZY_USER, lazy_exp, lazy_inc);
+    double lazy_monthly_secs = now_seconds() - t0;
+    t0 = now_seconds();
+    get_monthly_totals(REAL_USER, real_exp, real_inc);
+    double real_monthly_secs = now_seconds() - t0;
+    for (int m = 0; m < 12; m++) {
+        if (llround(lazy_exp[m] * 100.0) != llround(real_exp[m] * 100.0) ||
+            llround(lazy_inc[m] * 100.0) != llround(real_inc[m] * 100.0)) {
+            mismatches++;
+        }
+    }
+
+    // 5) Range totals, some running past today
+    struct balance_totals lazy, real;
+    t0 = now_seconds();
+    balance_range(LAZY_USER, first_day, today, &lazy);
+    balance_range(REAL_USER, first_day, today, &real);
+    double build_secs = now_seconds() - t0;
+
+    int *from = malloc(sizeof(int) * queries);
+    int *to = malloc(sizeof(int) * queries);
+    for (int q = 0; q < queries; q++) {
+        int a = first_day + rand() % (SPAN_DAYS + 365);
+        int b = first_day + rand() % (SPAN_DAYS + 365);
+        from[q] = a < b ? a : b;
+        to[q] = a < b ? b : a;
+    }
+    double lazy_secs = 0, real_secs = 0;
+    for (int q = 0; q < queries; q++) {
+        t0 = now_seconds();
+        balance_range(LAZY_USER, from[q], to[q], &lazy);
+        lazy_secs += now_seconds() - t0;
+        t0 = now_seconds();
+        balance_range(REAL_USER, from[q], to[q], &real);
+        real_secs += now_seconds() - t0;
+        if (lazy.income_cents != real.income_cents || lazy.expense_cents != real.expense_cents ||
+            lazy.balance_cents != real.balance_cents) {
+            mismatches++;
+        }
+    }
+
+    printf("%d rules (%d occurrences edited), %d materialised rows, %d random ranges\n",
+           rule_count, edits, rows, queries);
+    printf("  materialise rows       %10.2f ms\n", materialise_secs * 1e3);
+    printf("  monthly totals, lazy   %10.2f ms\n", lazy_monthly_secs * 1e3);
+    printf("  monthly totals, rows   %10.2f ms\n", real_monthly_secs * 1e3);
+    printf("  range index builds     %10.2f ms (both users)\n", build_secs * 1e3);
+    printf("  range query, lazy      %10.2f us/query\n", lazy_secs * 1e6 / queries);
+    printf("  range query, rows      %10.2f us/query\n", real_secs * 1e6 / queries);
+    printf("  mismatches             %10d (12 months + %d ranges)\n", mismatches, queries);
+
+    shard_close();
+    free(from);
+    free(to);
+
+    char cleanup[128];
+    snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dir);
+    system(cleanup);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,258 @@
+/******************************************************************************
+ * restart_bench.c
+ *
+ * Restart-to-steady-state time of a real server binary, cold restart
+ * (kill + start) versus --takeover (socket handoff + snapshot preload).
+ *
+ * A client logs in as each seeded user in turn and asks for a range report,
+ * which exercises the login cache and the per-user range index. After a
+ * warm-up the server is restarted while the client keeps going; steady
+ * state is reached once a full round of users runs without a failed or
+ * slow (above 2x the warm p99 + 1 ms) request.
+ *
+ * Build & run from Backend/ (after building ./server, see README.md):
+ *   gcc -O2 -I. -o restart_bench bench/restart_bench.c shard.c -lsqlite3 -lpthread
+ *   ./restart_bench ./server [users] [rows_per_user]
+ *
+ * Uses port 8080, so stop any other server first.
+ ******************************************************************************/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sqlite3.h>
+
+#include "shard.h"
+
+#define PORT            8080
+#define SETTLE_TIMEOUT  30.0    // seconds
+
+static char g_server[4096];
+static int g_users = 40;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// -------------------------------------------------------------------
+// HELPER: One HTTP request on a fresh connection. Returns the status
+// code, or -1 if the server could not be reached.
+static int http_request(const char *request)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        write(fd, request, strlen(request)) != (ssize_t)strlen(request)) {
+        close(fd);
+        return -1;
+    }
+
+    char response[8192];
+    size_t used = 0;
+    ssize_t n;
+    while (used < sizeof(response) - 1 && (n = read(fd, response + used, sizeof(response) - 1 - used)) > 0) {
+        used += (size_t)n;
+    }
+    close(fd);
+    response[used] = '\0';
+
+    int status = -1;
+    sscanf(response, "HTTP/1.1 %d", &status);
+    return status;
+}
+
+// Logs in as user u and asks for their range report; returns 1 if both succeed
+static int user_round_trip(int u)
+{
+    char login[256];
+    snprintf(login, sizeof(login),
+             "POST /login HTTP/1.1\r\n\r\n{\"username\":\"bench%d\",\"password\":\"pw\"}", u);
+    return http_request(login) == 200 &&
+           http_request("GET /reports/range?from=2016-01-01&to=2024-12-31 HTTP/1.1\r\n\r\n") == 200;
+}
+
+static pid_t start_server(int takeover)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        execl(g_server, g_server, "--no-rate-limit", takeover ? "--takeover" : NULL, (char *)NULL);
+        perror("execl");
+        _exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+static void wait_until_up(void)
+{
+    double deadline = now_seconds() + SETTLE_TIMEOUT;
+    while (http_request("GET /metrics HTTP/1.1\r\n\r\n") != 200) {
+        if (now_seconds() > deadline) {
+            fprintf(stderr, "server did not start\n");
+            exit(EXIT_FAILURE);
+        }
+        usleep(10000);
+    }
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// -------------------------------------------------------------------
+// Seeds users bench1..benchN with rows_per_user transactions each
+// -------------------------------------------------------------------
+static void seed(int rows_per_user)
+{
+    if (shard_init(1) < 0) {
+        exit(EXIT_FAILURE);
+    }
+    sqlite3 *db = shard_acquire(1);
+    sqlite3_stmt *user, *insert;
+
+    sqlite3_exec(db,
+        "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY AUTOINCREMENT, username TEXT UNIQUE, password TEXT);"
+        "BEGIN;", NULL, NULL, NULL);
+    sqlite3_prepare_v2(db, "INSERT INTO users (id, username, password) VALUES (?, ?, 'pw');", -1, &user, NULL);
+    sqlite3_prepare_v2(db,
+        "INSERT INTO transactions (user_id, trans_type, amount, date, category) "
+        "VALUES (?, ?, ?, date('2015-01-01', '+' || ? || ' days'), 'Bench');", -1, &insert, NULL);
+
+    srand(7);
+    for (int u = 1; u <= g_users; u++) {
+        char name[32];
+        snprintf(name, sizeof(name), "bench%d", u);
+        sqlite3_bind_int(user, 1, u);
+        sqlite3_bind_text(user, 2, name, -1, SQLITE_TRANSIENT);
+        sqlite3_step(user);
+        sqlite3_reset(user);
+
+        for (int i = 0; i < rows_per_user; i++) {
+            sqlite3_bind_int(insert, 1, u);
+            sqlite3_bind_text(insert, 2, (i % 4 == 0) ? "income" : "expense", -1, SQLITE_STATIC);
+            sqlite3_bind_double(insert, 3, (rand() % 100000) / 100.0);
+            sqlite3_bind_int(insert, 4, rand() % 3650);
+            sqlite3_step(insert);
+            sqlite3_reset(insert);
+        }
+    }
+    sqlite3_finalize(user);
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+    shard_release(1);
+    shard_close();
+}
+
+// -------------------------------------------------------------------
+// One restart under load
+// -------------------------------------------------------------------
+static void run_restart(int takeover)
+{
+    // 1) Fresh server, every user's caches warmed, then a timed warm round
+    pid_t old_pid = start_server(0);
+    wait_until_up();
+    for (int u = 1; u <= g_users; u++) {
+        user_round_trip(u);
+    }
+
+    double *warm = malloc(sizeof(double) * g_users);
+    for (int u = 1; u <= g_users; u++) {
+        double t = now_seconds();
+        user_round_trip(u);
+        warm[u - 1] = now_seconds() - t;
+    }
+    qsort(warm, g_users, sizeof(double), compare_double);
+    double p99 = warm[(g_users - 1) * 99 / 100];
+    double slow = 2 * p99 + 0.001;
+    free(warm);
+
+    // 2) Restart while the client keeps cycling through users
+    double t0 = now_seconds();
+    pid_t new_pid;
+    if (takeover) {
+        new_pid = start_server(1);
+    } else {
+        kill(old_pid, SIGTERM);
+        waitpid(old_pid, NULL, 0);
+        new_pid = start_server(0);
+    }
+
+    int failed = 0, good_streak = 0;
+    double last_bad = t0, worst = 0;
+    for (int u = 1; good_streak < g_users && now_seconds() - t0 < SETTLE_TIMEOUT; u = u % g_users + 1) {
+        double t = now_seconds();
+        int ok = user_round_trip(u);
+        double elapsed = now_seconds() - t;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+        if (!ok) {
+            failed++;
+            usleep(1000);
+        }
+        if (!ok || elapsed > slow) {
+            last_bad = now_seconds();
+            good_streak = 0;
+        } else {
+            good_streak++;
+        }
+    }
+
+    printf("%-9s %10.2f ms %8d %12.2f ms %14.2f ms\n",
+           takeover ? "takeover" : "cold", p99 * 1e3, failed, worst * 1e3, (last_bad - t0) * 1e3);
+
+    // 3) Leave nothing running for the next mode
+    if (takeover) {
+        waitpid(old_pid, NULL, 0);
+    }
+    kill(new_pid, SIGTERM);
+    waitpid(new_pid, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || !realpath(argv[1], g_server)) {
+        fprintf(stderr, "Usage: %s <server binary> [users] [rows_per_user]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    g_users = argc > 2 ? atoi(argv[2]) : 40;
+    int rows = argc > 3 ? atoi(argv[3]) : 10000;
+    if (g_users < 1 || g_users > 256 || rows < 1) {
+        fprintf(stderr, "users must be 1..256 (login cache size), rows >= 1\n");
+        return EXIT_FAILURE;
+    }
+
+    char dir[] = "/tmp/restart_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    seed(rows);
+
+    printf("%d users x %d rows\n", g_users, rows);
+    printf("%-9s %13s %8s %15s %17s\n", "restart", "warm p99", "failed", "worst", "to steady");
+    run_restart(0);
+    run_restart(1);
+
+    char cleanup[128];
+    snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dir);
+    system(cleanup);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ * shard_bench.c
+ *
+ * Insert throughput versus shard count. A fixed pool of writer threads
+ * calls handle_home_request() for random users; with more shards, fewer
+ * of those writers wait on the same database write lock.
+ *
+ * Build & run from Backend/:
+ *   gcc -O2 -I. -o shard_bench bench/shard_bench.c home.c shard.c storage.c \
+ *       txlog.c dates.c balance.c recurring.c \
+ *       transactions.c events.c http.c -lsqlite3 -lpthread -lm
+ *   ./shard_bench [threads] [inserts_per_thread]
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "home.h"
+#include "shard.h"
+
+static int g_inserts_per_thread = 500;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *writer(void *arg)
+{
+    unsigned int seed = (unsigned int)(size_t)arg;
+
+    for (int i = 0; i < g_inserts_per_thread; i++) {
+        char request[256];
+        snprintf(request, sizeof(request),
+                 "POST /home HTTP/1.1\r\n\r\n"
+                 "{\"type\":\"expense\",\"amount\":\"%d.50\",\"date\":\"2024-%02d-10\",\"category\":\"Food\"}",
+                 i % 300, i % 12 + 1);
+        char *response = handle_home_request(request, rand_r(&seed) % 10000 + 1);
+        free(response);
+    }
+    return NULL;
+}
+
+static void run_with_shards(int shards, int threads)
+{
+    // 1) Fresh scratch directory per run
+    char dir[] = "/tmp/shard_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0 || shard_init(shards) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 2) All writers start together
+    pthread_t tids[64];
+    double t0 = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&tids[t], NULL, writer, (void *)(size_t)(t + 1));
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    double secs = now_seconds() - t0;
+
+    printf("%2d shard(s) %3d thread(s) %10.0f inserts/s\n",
+           shards, threads, (double)threads * g_inserts_per_thread / secs);
+    shard_close();
+
+    char cleanup[128];
+    snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dir);
+    system(cleanup);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    g_inserts_per_thread = argc > 2 ? atoi(argv[2]) : 500;
+    const int shard_counts[] = { 1, 2, 4, 8 };
+
+    if (threads < 1 || threads > 64 || g_inserts_per_thread < 1) {
+        fprintf(stderr, "Usage: %s [threads 1..64] [inserts_per_thread]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(shard_counts) / sizeof(shard_counts[0]); i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_with_shards(shard_counts[i], threads);
+            exit(EXIT_SUCCESS);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+/******************************************************************************
+ * storage_bench.c
+ *
+ * Compares the two transaction storage engines through the same entry
+ * points the server uses: handle_home_request() for inserts and
+ * get_monthly_totals() for aggregation.
+ *
+ * Build & run from Backend/:
+ *   gcc -O2 -I. -o storage_bench bench/storage_bench.c home.c transactions.c \
+ *       storage.c txlog.c dates.c shard.c balance.c recurring.c events.c http.c -lsqlite3 -lpthread -lm
+ *   ./storage_bench [rows] [users] [aggregate_rounds]
+ *
+ * Each engine runs in a forked child inside a fresh temporary directory,
+ * so neither sees the other's data and the real transactions.db is untouched.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "home.h"
+#include "shard.h"
+#include "storage.h"
+#include "transactions.h"
+#include "txlog.h"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run_engine(const char *engine, int rows, int users, int rounds)
+{
+    // 1) Work inside a scratch directory
+    char dir[] = "/tmp/storage_bench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+    if (shard_init(1) < 0 || storage_init(engine) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    // 2) Inserts, spread over users and dates
+    double t0 = now_seconds();
+    for (int i = 0; i < rows; i++) {
+        char request[512];
+        snprintf(request, sizeof(request),
+                 "POST /home HTTP/1.1\r\n\r\n"
+                 "{\"type\":\"%s\",\"amount\":\"%d.%02d\",\"date\":\"2024-%02d-%02d\",\"category\":\"Food\"}",
+                 (i % 5 == 0) ? "income" : "expense", i % 1000, i % 100, i % 12 + 1, i % 28 + 1);
+        char *response = handle_home_request(request, i % users + 1);
+        if (strstr(response, "200 OK") == NULL) {
+            fprintf(stderr, "%s: insert %d failed\n", engine, i);
+            exit(EXIT_FAILURE);
+        }
+        free(response);
+    }
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        txlog_sync();   // count the final group commit
+    }
+    double insert_secs = now_seconds() - t0;
+
+    // 3) Aggregates: monthly totals for every user, several rounds
+    double checksum = 0;
+    t0 = now_seconds();
+    for (int r = 0; r < rounds; r++) {
+        for (int u = 1; u <= users; u++) {
+            double expenses[12], income[12];
+            get_monthly_totals(u, expenses, income);
+            checksum += expenses[0] + income[0];
+        }
+    }
+    double aggregate_secs = now_seconds() - t0;
+
+    printf("%-7s %9d rows %10.0f inserts/s %10.0f aggregates/s  (checksum %.2f)\n",
+           engine, rows, rows / insert_secs, (double)rounds * users / aggregate_secs,
+           checksum / rounds);
+
+    storage_shutdown();
+    shard_close();
+
+    // 4) Drop the scratch data
+    char cleanup[128];
+    snprintf(cleanup, sizeof(cleanup), "rm -rf %s", dir);
+    system(cleanup);
+}
+
+int main(int argc, char *argv[])
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 5000;
+    int users = argc > 2 ? atoi(argv[2]) : 50;
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+    const char *engines[] = { "sqlite", "txlog" };
+
+    if (rows < 1 || users < 1 || rounds < 1) {
+        fprintf(stderr, "Usage: %s [rows] [users] [aggregate_rounds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_engine(engines[i], rows, users, rounds);
+            exit(EXIT_SUCCESS);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    return 0;
+}
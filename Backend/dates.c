@@ -0,0 +1,77 @@
+/******************************************************************************
+ * dates.c
+ *
+ * Calendar arithmetic on plain day numbers, so that date ranges can be
+ * compared and bucketed without going through SQLite's date functions.
+ * Uses the days-from-civil algorithm (proleptic Gregorian calendar).
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <stdio.h>
+
+#include "dates.h"
+
+int days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;                                   // [0, 399]
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;  // [0, 365]
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+
+int days_in_month(int year, int month)
+{
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return days[month - 1] + (month == 2 && leap);
+}
+
+void day_to_civil(int day, int *year, int *month, int *mday)
+{
+    int z = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    int d = doy - (153 * mp + 2) / 5 + 1;
+    int m = mp + (mp < 10 ? 3 : -9);
+
+    *year = yoe + era * 400 + (m <= 2);
+    *month = m;
+    *mday = d;
+}
+
+int date_to_day(const char *s, int *out_day)
+{
+    // Expect "YYYY-MM-DD", optionally followed by a time part
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) {
+            if (s[i] != '-') return 0;
+        } else if (!isdigit((unsigned char)s[i])) {
+            return 0;
+        }
+    }
+    if (s[10] != '\0' && s[10] != ' ' && s[10] != 'T') {
+        return 0;
+    }
+
+    int y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+    int m = (s[5] - '0') * 10 + (s[6] - '0');
+    int d = (s[8] - '0') * 10 + (s[9] - '0');
+    if (m < 1 || m > 12 || d < 1 || d > 31) {
+        return 0;
+    }
+
+    *out_day = days_from_civil(y, m, d);
+    return 1;
+}
+
+void day_to_date(int day, char *out, size_t out_size)
+{
+    int y, m, d;
+    day_to_civil(day, &y, &m, &d);
+    snprintf(out, out_size, "%04d-%02d-%02d", y, m, d);
+}
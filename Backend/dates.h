@@ -0,0 +1,24 @@
+#ifndef DATES_H
+#define DATES_H
+
+#include <stddef.h>
+
+// Parses the leading "YYYY-MM-DD" of s into a day number (days since
+// 1970-01-01). Day-of-month overflow is normalised the same way SQLite's
+// date functions do it ("2025-02-30" is March 2nd).
+// Returns 1 on success, 0 if s does not start with a date.
+int date_to_day(const char *s, int *out_day);
+
+// Day number of year-month-mday (month 1..12, mday 1..days_in_month).
+int days_from_civil(int year, int month, int mday);
+
+// 28..31 for the given year and month (1..12).
+int days_in_month(int year, int month);
+
+// Converts a day number back to year, month (1..12) and day (1..31).
+void day_to_civil(int day, int *year, int *month, int *mday);
+
+// Writes day as "YYYY-MM-DD" into out (at least 11 bytes).
+void day_to_date(int day, char *out, size_t out_size);
+
+#endif
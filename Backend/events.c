@@ -0,0 +1,355 @@
+/******************************************************************************
+ * events.c
+ *
+ * Fan-out registry behind GET /events.
+ *
+ *   - Streams live in one fixed array; each user's streams are chained
+ *     from a hash bucket, so a publish touches only that user's sockets.
+ *   - Links are stored as slot + 1 so the zeroed static tables are a valid
+ *     empty registry; freed slots go on a free list.
+ *   - The accept loop never polls stream sockets. It sleeps until the next
+ *     heartbeat at most; each heartbeat also peeks for EOF to reap streams
+ *     whose client went away.
+ *   - Monthly totals for a delta are computed once per publish, and only
+ *     when the user has a stream open, so inserts by users without an open
+ *     dashboard pay one hash lookup.
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "events.h"
+#include "http.h"
+#include "transactions.h"
+
+#define EVENTS_CHAINS      1024     // user_id hash buckets
+#define EVENTS_FD_HEADROOM 1024     // fds kept for requests, shards and logs
+#define EVENTS_RETRY_MS    2000     // EventSource reconnect delay
+
+struct event_stream {
+    int fd;
+    int user_id;                // 0 = not registered
+    int next;                   // next slot + 1 in the chain or free list, 0 = end
+};
+
+static struct event_stream g_streams[EVENTS_MAX_STREAMS];
+static int g_chains[EVENTS_CHAINS];     // first slot + 1, 0 = empty
+static int g_free = 0;                  // free list head (slot + 1)
+static int g_high_water = 0;            // slots [0, g_high_water) have been handed out
+static int g_open = 0;
+static long long g_next_heartbeat_ms = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_ullong g_opened;
+static atomic_ullong g_dropped;
+static atomic_ullong g_sent;
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static int chain_of(int user_id)
+{
+    return (int)((unsigned int)user_id % EVENTS_CHAINS);
+}
+
+// Whole event or nothing: a partial write would corrupt the stream.
+static int write_now(int fd, const char *data, size_t len)
+{
+    return write(fd, data, len) == (ssize_t)len ? 0 : -1;
+}
+
+// -------------------------------------------------------------------
+// Registry (called with g_lock held)
+// -------------------------------------------------------------------
+static int claim_slot(void)
+{
+    if (g_free) {
+        int slot = g_free - 1;
+        g_free = g_streams[slot].next;
+        return slot;
+    }
+    return g_high_water < EVENTS_MAX_STREAMS ? g_high_water++ : -1;
+}
+
+static void release_slot(int slot)
+{
+    g_streams[slot].user_id = 0;
+    g_streams[slot].next = g_free;
+    g_free = slot + 1;
+}
+
+// Unlinks a registered stream, closes its socket and frees the slot.
+static void drop_stream(int slot)
+{
+    struct event_stream *s = &g_streams[slot];
+    int *link = &g_chains[chain_of(s->user_id)];
+    while (*link && *link != slot + 1) {
+        link = &g_streams[*link - 1].next;
+    }
+    if (*link) {
+        *link = s->next;
+    }
+    close(s->fd);
+    release_slot(slot);
+    g_open--;
+}
+
+static int has_streams(int user_id)
+{
+    int found = 0;
+    pthread_mutex_lock(&g_lock);
+    for (int link = g_chains[chain_of(user_id)]; link && !found; link = g_streams[link - 1].next) {
+        found = g_streams[link - 1].user_id == user_id;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return found;
+}
+
+static void send_to_user(int user_id, const char *event, size_t len)
+{
+    pthread_mutex_lock(&g_lock);
+    int link = g_chains[chain_of(user_id)];
+    while (link) {
+        int slot = link - 1;
+        link = g_streams[slot].next;
+        if (g_streams[slot].user_id != user_id) {
+            continue;
+        }
+        if (write_now(g_streams[slot].fd, event, len) < 0) {
+            drop_stream(slot);      // gone, or too far behind to catch up
+            atomic_fetch_add(&g_dropped, 1);
+        } else {
+            atomic_fetch_add(&g_sent, 1);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// "monthly":{"expenses":[12 sums],"income":[12 sums]}
+static int format_monthly(int user_id, char *out, size_t out_size)
+{
+    double expenses[12];
+    double income[12];
+    if (get_monthly_totals(user_id, expenses, income) != 0) {
+        return -1;
+    }
+
+    size_t len = snprintf(out, out_size, "\"monthly\":{\"expenses\":[");
+    for (int i = 0; i < 12 && len < out_size; i++) {
+        len += snprintf(out + len, out_size - len, "%s%.2f", i ? "," : "", expenses[i]);
+    }
+    if (len < out_size) {
+        len += snprintf(out + len, out_size - len, "],\"income\":[");
+    }
+    for (int i = 0; i < 12 && len < out_size; i++) {
+        len += snprintf(out + len, out_size - len, "%s%.2f", i ? "," : "", income[i]);
+    }
+    if (len < out_size) {
+        len += snprintf(out + len, out_size - len, "]}");
+    }
+    return len < out_size ? 0 : -1;
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+void events_init(void)
+{
+    struct rlimit limit;
+    rlim_t wanted = EVENTS_MAX_STREAMS + EVENTS_FD_HEADROOM;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < wanted) {
+        limit.rlim_cur = limit.rlim_max < wanted ? limit.rlim_max : wanted;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int events_open(int socket_fd, int user_id)
+{
+    static const char headers[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    char preamble[64];
+
+    // 1) Reserve a slot before answering, so a full registry can still 503
+    pthread_mutex_lock(&g_lock);
+    int slot = claim_slot();
+    pthread_mutex_unlock(&g_lock);
+    if (slot < 0) {
+        return -1;
+    }
+
+    // 2) Headers and reconnect delay while the socket still blocks
+    snprintf(preamble, sizeof(preamble), "retry: %d\n\n", EVENTS_RETRY_MS);
+    if (http_write_all(socket_fd, headers, sizeof(headers) - 1) < 0 ||
+        http_write_all(socket_fd, preamble, strlen(preamble)) < 0) {
+        close(socket_fd);
+        pthread_mutex_lock(&g_lock);
+        release_slot(slot);
+        pthread_mutex_unlock(&g_lock);
+        return 0;
+    }
+    fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+
+    // 3) Link it into the user's chain
+    pthread_mutex_lock(&g_lock);
+    int chain = chain_of(user_id);
+    g_streams[slot].fd = socket_fd;
+    g_streams[slot].user_id = user_id;
+    g_streams[slot].next = g_chains[chain];
+    g_chains[chain] = slot + 1;
+    if (g_open++ == 0) {
+        g_next_heartbeat_ms = now_ms() + EVENTS_HEARTBEAT_SEC * 1000LL;
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    atomic_fetch_add(&g_opened, 1);
+    return 0;
+}
+
+void events_publish_transaction(int user_id, int id, const char *type, double amount,
+                                const char *date, const char *category, const char *note)
+{
+    if (!has_streams(user_id)) {
+        return;
+    }
+
+    char monthly[1024];
+    if (format_monthly(user_id, monthly, sizeof(monthly)) < 0) {
+        return;
+    }
+
+    char type_esc[128];
+    char date_esc[128];
+    char category_esc[256];
+    char note_esc[1536];
+    http_json_escape(type, type_esc, sizeof(type_esc));
+    http_json_escape(date, date_esc, sizeof(date_esc));
+    http_json_escape(category, category_esc, sizeof(category_esc));
+    http_json_escape(note, note_esc, sizeof(note_esc));
+
+    char event[4096];
+    int len = snprintf(event, sizeof(event),
+                       "event: transaction\n"
+                       "data: {\"transaction\":{\"id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,"
+                       "\"date\":\"%s\",\"category\":\"%s\",\"note\":\"%s\"},%s}\n\n",
+                       id, type_esc, amount, date_esc, category_esc, note_esc, monthly);
+    if (len > 0 && (size_t)len < sizeof(event)) {
+        send_to_user(user_id, event, (size_t)len);
+    }
+}
+
+void events_publish_recurring(int user_id)
+{
+    if (!has_streams(user_id)) {
+        return;
+    }
+
+    char monthly[1024];
+    if (format_monthly(user_id, monthly, sizeof(monthly)) < 0) {
+        return;
+    }
+
+    char event[1200];
+    int len = snprintf(event, sizeof(event), "event: recurring\ndata: {%s}\n\n", monthly);
+    if (len > 0 && (size_t)len < sizeof(event)) {
+        send_to_user(user_id, event, (size_t)len);
+    }
+}
+
+int events_poll_timeout(void)
+{
+    int timeout = -1;
+
+    pthread_mutex_lock(&g_lock);
+    if (g_open > 0) {
+        long long wait = g_next_heartbeat_ms - now_ms();
+        timeout = wait > 0 ? (int)wait : 0;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return timeout;
+}
+
+void events_heartbeat(void)
+{
+    static const char ping[] = ": ping\n\n";
+
+    pthread_mutex_lock(&g_lock);
+    long long now = now_ms();
+    if (g_open == 0 || now < g_next_heartbeat_ms) {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_next_heartbeat_ms = now + EVENTS_HEARTBEAT_SEC * 1000LL;
+
+    for (int slot = 0; slot < g_high_water; slot++) {
+        if (g_streams[slot].user_id == 0) {
+            continue;
+        }
+
+        // EventSource never sends a body, so readable means EOF or reset
+        char c;
+        ssize_t n = recv(g_streams[slot].fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        int gone = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+        if (gone || write_now(g_streams[slot].fd, ping, sizeof(ping) - 1) < 0) {
+            drop_stream(slot);
+            atomic_fetch_add(&g_dropped, 1);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+void events_close_all(void)
+{
+    pthread_mutex_lock(&g_lock);
+    for (int slot = 0; slot < g_high_water; slot++) {
+        if (g_streams[slot].user_id != 0) {
+            drop_stream(slot);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+char *events_metrics(void)
+{
+    pthread_mutex_lock(&g_lock);
+    int open = g_open;
+    pthread_mutex_unlock(&g_lock);
+
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "# HELP event_streams_open Open GET /events streams.\n"
+             "# TYPE event_streams_open gauge\n"
+             "event_streams_open %d\n"
+             "# HELP event_streams_opened_total GET /events streams accepted.\n"
+             "# TYPE event_streams_opened_total counter\n"
+             "event_streams_opened_total %llu\n"
+             "# HELP event_streams_dropped_total Streams closed because the client left or fell behind.\n"
+             "# TYPE event_streams_dropped_total counter\n"
+             "event_streams_dropped_total %llu\n"
+             "# HELP events_sent_total Events written to streams, heartbeats excluded.\n"
+             "# TYPE events_sent_total counter\n"
+             "events_sent_total %llu\n",
+             open,
+             (unsigned long long)atomic_load(&g_opened),
+             (unsigned long long)atomic_load(&g_dropped),
+             (unsigned long long)atomic_load(&g_sent));
+    return strdup(text);
+}
@@ -0,0 +1,49 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+// GET /events: Server-Sent Events streams, so open dashboards see new
+// transactions without re-fetching /transactions.
+//
+// A stream is just a registered socket: after the response headers it is
+// switched to non-blocking and never polled. Writes happen only when that
+// user's data changes or a heartbeat is due, so thousands of idle streams
+// cost one fd each and nothing per loop iteration. A stream that cannot
+// take a whole event without blocking is closed; EventSource reconnects.
+// All functions are safe to call from any thread.
+
+#define EVENTS_MAX_STREAMS   8192
+#define EVENTS_HEARTBEAT_SEC 15
+
+// Raises the open-file limit so idle streams do not starve accept().
+void events_init(void);
+
+// Sends the event-stream headers and registers socket_fd for user_id.
+// Returns 0 once the registry has taken the socket (closing it if the
+// client is already gone), -1 when it is full: the caller still owns and
+// closes the socket then.
+int events_open(int socket_fd, int user_id);
+
+// Event "transaction": {"transaction":{row as in /transactions},"monthly":{...}}
+// Monthly totals are only computed when the user has an open stream.
+void events_publish_transaction(int user_id, int id, const char *type, double amount,
+                                const char *date, const char *category, const char *note);
+
+// Event "recurring": {"monthly":{...}}. Rules or occurrences changed;
+// the list itself is re-read by the client.
+void events_publish_recurring(int user_id);
+
+// Milliseconds until the next heartbeat is due, or -1 with no streams.
+// The accept loop uses it as its poll() timeout.
+int events_poll_timeout(void);
+
+// Sends a heartbeat comment to every stream when due, dropping streams
+// whose client has gone away.
+void events_heartbeat(void);
+
+// Closes every stream (before handing the listening socket over).
+void events_close_all(void);
+
+// Stream gauges and counters for GET /metrics (malloc'd).
+char *events_metrics(void);
+
+#endif
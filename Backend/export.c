@@ -0,0 +1,419 @@
+/******************************************************************************
+ * export.c
+ *
+ * GET /transactions/export?format=csv|ndjson&from=YYYY-MM-DD&to=YYYY-MM-DD
+ *
+ * Rows are read with a forward-only sqlite3_step cursor and copied into a
+ * fixed-size buffer that is sent as one HTTP chunk whenever it fills up.
+ * Writes are blocking, so a slow client simply slows the cursor down and
+ * memory use stays at one buffer per export no matter how many rows exist.
+ * Each export runs on its own detached thread with its own read-only
+ * connection, so the main accept loop keeps serving other requests.
+ * With --storage txlog the rows come from the log's per-user index instead.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sqlite3.h>
+
+#include "admission.h"
+#include "dates.h"
+#include "export.h"
+#include "http.h"
+#include "shard.h"
+#include "storage.h"
+#include "txlog.h"
+
+#define EXPORT_BUFFER_SIZE (16 * 1024)
+#define EXPORT_SEND_TIMEOUT_SEC 30
+#define EXPORT_TXLOG_BATCH 64
+
+enum export_format {
+    EXPORT_CSV,
+    EXPORT_NDJSON
+};
+
+struct export_job {
+    int socket_fd;
+    int user_id;
+    enum export_format format;
+    char from[16];
+    char to[16];
+    int has_from;
+    int has_to;
+    int from_day;               // day numbers of from/to (see dates.h)
+    int to_day;
+
+    // Output buffer: flushed as a single chunk when full
+    size_t used;
+    int failed;
+    char buf[EXPORT_BUFFER_SIZE];
+};
+
+// -------------------------------------------------------------------
+// HELPER: Send the buffered bytes as one chunk of a chunked response.
+static void export_flush(struct export_job *job)
+{
+    if (job->used == 0 || job->failed) {
+        job->used = 0;
+        return;
+    }
+
+    char chunk_header[32];
+    int header_len = snprintf(chunk_header, sizeof(chunk_header), "%zx\r\n", job->used);
+
+    if (http_write_all(job->socket_fd, chunk_header, (size_t)header_len) < 0 ||
+        http_write_all(job->socket_fd, job->buf, job->used) < 0 ||
+        http_write_all(job->socket_fd, "\r\n", 2) < 0) {
+        job->failed = 1;
+    }
+    job->used = 0;
+}
+
+static void export_putc(struct export_job *job, char c)
+{
+    if (job->used == EXPORT_BUFFER_SIZE) {
+        export_flush(job);
+    }
+    job->buf[job->used++] = c;
+}
+
+static void export_puts(struct export_job *job, const char *s)
+{
+    while (*s) {
+        export_putc(job, *s++);
+    }
+}
+
+// -------------------------------------------------------------------
+// HELPER: CSV field, quoted only when it contains a separator or quote.
+static void export_csv_field(struct export_job *job, const char *s)
+{
+    if (strpbrk(s, ",\"\r\n") == NULL) {
+        export_puts(job, s);
+        return;
+    }
+
+    export_putc(job, '"');
+    for (; *s; s++) {
+        if (*s == '"') {
+            export_putc(job, '"');
+        }
+        export_putc(job, *s);
+    }
+    export_putc(job, '"');
+}
+
+// -------------------------------------------------------------------
+// HELPER: JSON string literal with the mandatory escapes.
+static void export_json_string(struct export_job *job, const char *s)
+{
+    export_putc(job, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            export_putc(job, '\\');
+            export_putc(job, (char)c);
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            export_puts(job, esc);
+        } else {
+            export_putc(job, (char)c);
+        }
+    }
+    export_putc(job, '"');
+}
+
+// -------------------------------------------------------------------
+// HELPER: Status line and headers; the body is chunked because its
+// length is unknown up front.
+static int export_send_headers(struct export_job *job)
+{
+    int is_csv = (job->format == EXPORT_CSV);
+    char headers[512];
+    snprintf(headers, sizeof(headers),
+        "HTTP/1.1 200 OK\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+        "Access-Control-Allow-Headers: Content-Type\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Disposition: attachment; filename=\"transactions.%s\"\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        is_csv ? "text/csv; charset=utf-8" : "application/x-ndjson",
+        is_csv ? "csv" : "ndjson");
+
+    if (http_write_all(job->socket_fd, headers, strlen(headers)) < 0) {
+        return -1;
+    }
+    if (is_csv) {
+        export_puts(job, "id,trans_type,amount,date,category,note\r\n");
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// HELPER: One CSV line or NDJSON object.
+static void export_row(struct export_job *job, int id, const char *trans_type,
+                       double amount, const char *date, const char *category, const char *note)
+{
+    char number[64];
+    if (job->format == EXPORT_CSV) {
+        snprintf(number, sizeof(number), "%d,", id);
+        export_puts(job, number);
+        export_csv_field(job, trans_type);
+        snprintf(number, sizeof(number), ",%.2f,", amount);
+        export_puts(job, number);
+        export_csv_field(job, date);
+        export_putc(job, ',');
+        export_csv_field(job, category);
+        export_putc(job, ',');
+        export_csv_field(job, note);
+        export_puts(job, "\r\n");
+    } else {
+        snprintf(number, sizeof(number), "{\"id\":%d,\"trans_type\":", id);
+        export_puts(job, number);
+        export_json_string(job, trans_type);
+        snprintf(number, sizeof(number), ",\"amount\":%.2f,\"date\":", amount);
+        export_puts(job, number);
+        export_json_string(job, date);
+        export_puts(job, ",\"category\":");
+        export_json_string(job, category);
+        export_puts(job, ",\"note\":");
+        export_json_string(job, note);
+        export_puts(job, "}\n");
+    }
+}
+
+// -------------------------------------------------------------------
+// HELPER: Terminate the chunked body. Only called when every row was
+// produced, so a client can tell a truncated export from a complete one.
+static void export_finish(struct export_job *job)
+{
+    export_flush(job);
+    if (!job->failed) {
+        http_write_all(job->socket_fd, "0\r\n\r\n", 5);
+    }
+}
+
+// -------------------------------------------------------------------
+// SQLite engine: forward-only cursor over the transactions table.
+// -------------------------------------------------------------------
+static int export_is_wal(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int wal = 0;
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            const unsigned char *mode = sqlite3_column_text(stmt, 0);
+            wal = mode && strcmp((const char *)mode, "wal") == 0;
+        }
+        sqlite3_finalize(stmt);
+    }
+    return wal;
+}
+
+static void export_from_sqlite(struct export_job *job)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    // 1) Open a private read-only connection to the user's shard; WAL keeps
+    //    the long-running cursor from blocking the shard writer
+    char path[64];
+    shard_path_for_user(job->user_id, path, sizeof(path));
+    rc = sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Export: cannot open database: %s\n", sqlite3_errmsg(db));
+        send_response(job->socket_fd, "HTTP/1.1 500 Internal Server Error", "text/plain", "Database error occurred.");
+        sqlite3_close(db);
+        return;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    // shard_init switches every shard to WAL before the first request. In
+    // rollback-journal mode this cursor's SHARED lock would make inserts
+    // fail for the whole export, so refuse rather than block them.
+    if (!export_is_wal(db)) {
+        fprintf(stderr, "Export: %s is not in WAL mode\n", path);
+        send_response(job->socket_fd, "HTTP/1.1 503 Service Unavailable", "text/plain", "Export unavailable");
+        sqlite3_close(db);
+        return;
+    }
+
+    // 2) Rows in date order; NULL bounds mean "unbounded"
+    const char *sql =
+        "SELECT id, trans_type, amount, date, category, note "
+        "FROM transactions "
+        "WHERE user_id = ?1 "
+        "  AND (?2 IS NULL OR date >= ?2) "
+        "  AND (?3 IS NULL OR date <= ?3) "
+        "ORDER BY date, id;";
+
+    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Export: failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        send_response(job->socket_fd, "HTTP/1.1 500 Internal Server Error", "text/plain", "Database error occurred.");
+        sqlite3_close(db);
+        return;
+    }
+
+    sqlite3_bind_int(stmt, 1, job->user_id);
+    if (job->has_from) {
+        sqlite3_bind_text(stmt, 2, job->from, -1, SQLITE_STATIC);
+    }
+    if (job->has_to) {
+        sqlite3_bind_text(stmt, 3, job->to, -1, SQLITE_STATIC);
+    }
+
+    // 3) Stream rows; the buffer flushes itself whenever it fills
+    if (export_send_headers(job) == 0) {
+        while (!job->failed && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char *trans_type_raw = sqlite3_column_text(stmt, 1);
+            const unsigned char *date_raw = sqlite3_column_text(stmt, 3);
+            const unsigned char *category_raw = sqlite3_column_text(stmt, 4);
+            const unsigned char *note_raw = sqlite3_column_text(stmt, 5);
+
+            export_row(job,
+                       sqlite3_column_int(stmt, 0),
+                       trans_type_raw ? (const char*)trans_type_raw : "",
+                       sqlite3_column_double(stmt, 2),
+                       date_raw ? (const char*)date_raw : "",
+                       category_raw ? (const char*)category_raw : "",
+                       note_raw ? (const char*)note_raw : "");
+        }
+
+        if (rc == SQLITE_DONE) {
+            export_finish(job);
+        } else if (!job->failed) {
+            fprintf(stderr, "Export: cursor failed: %s\n", sqlite3_errmsg(db));
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+}
+
+// -------------------------------------------------------------------
+// txlog engine: the per-user index is already in (day, id) order, so a
+// small batch buffer walks it with the same constant memory.
+// -------------------------------------------------------------------
+static void export_from_txlog(struct export_job *job)
+{
+    struct txlog_record batch[EXPORT_TXLOG_BATCH];
+    struct txlog_cursor cursor = {0};
+    size_t n;
+
+    if (job->has_from) {
+        // Everything ordered after (from_day, INT32_MIN), i.e. day >= from_day
+        cursor.started = 1;
+        cursor.day = job->from_day;
+        cursor.id = INT32_MIN;
+    }
+
+    if (export_send_headers(job) < 0) {
+        return;
+    }
+
+    while (!job->failed && (n = txlog_read_user(job->user_id, &cursor, 0, batch, EXPORT_TXLOG_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (job->has_to && batch[i].day > job->to_day) {
+                export_finish(job);
+                return;
+            }
+            // Log records never hold a note (see txlog_fits), so the column is empty
+            export_row(job, batch[i].id, batch[i].trans_type, batch[i].amount_cents / 100.0,
+                       batch[i].date, batch[i].category, "");
+        }
+    }
+    export_finish(job);
+}
+
+// -------------------------------------------------------------------
+// Thread body: stream every row, then release the socket.
+// -------------------------------------------------------------------
+static void *export_thread(void *arg)
+{
+    struct export_job *job = (struct export_job *)arg;
+
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        export_from_txlog(job);
+    } else {
+        export_from_sqlite(job);
+    }
+
+    close(job->socket_fd);
+    free(job);
+    admission_leave_expensive();
+    return NULL;
+}
+
+void start_transactions_export(int socket_fd, int user_id, const char *query)
+{
+    // 1) Parse and validate the query string
+    char format[16] = "csv";
+    http_query_param(query, "format", format, sizeof(format));
+
+    struct export_job *job = calloc(1, sizeof(*job));
+    if (!job) {
+        send_response(socket_fd, "HTTP/1.1 500 Internal Server Error", "text/plain", "Out of memory");
+        close(socket_fd);
+        return;
+    }
+    job->socket_fd = socket_fd;
+    job->user_id = user_id;
+
+    if (strcmp(format, "csv") == 0) {
+        job->format = EXPORT_CSV;
+    } else if (strcmp(format, "ndjson") == 0) {
+        job->format = EXPORT_NDJSON;
+    } else {
+        send_response(socket_fd, "HTTP/1.1 400 Bad Request", "text/plain", "format must be csv or ndjson");
+        close(socket_fd);
+        free(job);
+        return;
+    }
+
+    job->has_from = http_query_param(query, "from", job->from, sizeof(job->from)) && job->from[0];
+    job->has_to = http_query_param(query, "to", job->to, sizeof(job->to)) && job->to[0];
+    if ((job->has_from && (!http_is_date(job->from) || !date_to_day(job->from, &job->from_day))) ||
+        (job->has_to && (!http_is_date(job->to) || !date_to_day(job->to, &job->to_day)))) {
+        send_response(socket_fd, "HTTP/1.1 400 Bad Request", "text/plain", "from/to must be YYYY-MM-DD");
+        close(socket_fd);
+        free(job);
+        return;
+    }
+
+    // 2) Exports count against the expensive-route limit until they finish
+    if (!admission_enter_expensive()) {
+        admission_reject(socket_fd);
+        free(job);
+        return;
+    }
+
+    // 3) Don't let a stalled client pin the export thread forever
+    struct timeval timeout = { EXPORT_SEND_TIMEOUT_SEC, 0 };
+    setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // 4) Hand the socket to a detached worker thread
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, export_thread, job) != 0) {
+        perror("pthread_create");
+        send_response(socket_fd, "HTTP/1.1 503 Service Unavailable", "text/plain", "Export unavailable");
+        close(socket_fd);
+        free(job);
+        admission_leave_expensive();
+    }
+    pthread_attr_destroy(&attr);
+}
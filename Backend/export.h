@@ -0,0 +1,14 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+// Streams user_id's transactions to socket_fd as CSV or NDJSON, with the
+// columns id, trans_type, amount, date, category and note.
+// query is the raw query string: format=csv|ndjson&from=YYYY-MM-DD&to=YYYY-MM-DD
+//
+// Takes ownership of socket_fd: the export runs on its own thread and the
+// socket is closed when the stream ends (or right away on a bad request).
+// The export holds an expensive-route slot (admission.h) while it runs and
+// is answered with 429 when none is free.
+void start_transactions_export(int socket_fd, int user_id, const char *query);
+
+#endif
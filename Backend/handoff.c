@@ -0,0 +1,175 @@
+/******************************************************************************
+ * handoff.c
+ *
+ * Restart sequence (./server --takeover next to a running server):
+ *
+ *   new                              old
+ *   connect server.sock  ---------->
+ *   "TAKEOVER\n"         ---------->  stop accepting, save snapshot
+ *                        <----------  listening socket (SCM_RIGHTS)
+ *   load snapshot, accept            drain exports, close storage, exit
+ *
+ * The listening socket is never closed in between, so clients only see
+ * the snapshot save/load time as extra latency.
+ ******************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "handoff.h"
+#include "admission.h"
+
+#define HANDOFF_REQUEST       "TAKEOVER\n"
+#define HANDOFF_TIMEOUT_SEC   10      // reply wait for the new process
+#define HANDOFF_DRAIN_SEC     30      // longest wait for running exports
+
+static void socket_address(struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", HANDOFF_SOCKET);
+}
+
+int handoff_listen(void)
+{
+    struct sockaddr_un addr;
+    socket_address(&addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("handoff socket");
+        return -1;
+    }
+
+    // The previous process (if any) has already handed over; its path is stale
+    unlink(HANDOFF_SOCKET);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        perror("handoff bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int handoff_accept(int control_fd)
+{
+    int conn = accept(control_fd, NULL, NULL);
+    if (conn < 0) {
+        return -1;
+    }
+
+    // A stray client must not block the accept loop
+    struct timeval timeout = { 1, 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[sizeof(HANDOFF_REQUEST)] = {0};
+    ssize_t n = recv(conn, request, sizeof(request) - 1, MSG_WAITALL);
+    if (n != (ssize_t)strlen(HANDOFF_REQUEST) || strcmp(request, HANDOFF_REQUEST) != 0) {
+        close(conn);
+        return -1;
+    }
+    return conn;
+}
+
+int handoff_send(int conn_fd, int server_fd)
+{
+    // One payload byte carries the descriptor
+    char byte = 'F';
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &server_fd, sizeof(int));
+
+    int rc = sendmsg(conn_fd, &msg, 0) == 1 ? 0 : -1;
+    if (rc < 0) {
+        perror("handoff sendmsg");
+    }
+    close(conn_fd);
+    return rc;
+}
+
+void handoff_drain(void)
+{
+    struct timespec pause = { 0, 50 * 1000000L };
+    for (int waited = 0; admission_in_flight() > 0 && waited < HANDOFF_DRAIN_SEC * 20; waited++) {
+        nanosleep(&pause, NULL);
+    }
+    if (admission_in_flight() > 0) {
+        fprintf(stderr, "Drain timed out with %d export(s) still running\n", admission_in_flight());
+    }
+}
+
+int handoff_request(void)
+{
+    struct sockaddr_un addr;
+    socket_address(&addr);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // The old process may be draining txlog exports before it replies
+    struct timeval timeout = { HANDOFF_TIMEOUT_SEC + HANDOFF_DRAIN_SEC, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (send(fd, HANDOFF_REQUEST, strlen(HANDOFF_REQUEST), 0) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Receive the descriptor
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    close(fd);
+
+    struct cmsghdr *cmsg = n == 1 ? CMSG_FIRSTHDR(&msg) : NULL;
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        fprintf(stderr, "Takeover failed: no socket received\n");
+        return -1;
+    }
+    int server_fd;
+    memcpy(&server_fd, CMSG_DATA(cmsg), sizeof(int));
+    return server_fd;
+}
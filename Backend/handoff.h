@@ -0,0 +1,30 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+// Zero-downtime restart. A running server listens on a Unix control socket;
+// a new process started with --takeover connects to it and receives the
+// listening TCP socket itself (SCM_RIGHTS), so connections that arrive
+// during the restart wait in the kernel backlog instead of being refused.
+
+#define HANDOFF_SOCKET "server.sock"
+
+// Old process: creates the control socket (replacing a stale one).
+// Returns its fd, or -1 (restarts then fall back to a cold start).
+int handoff_listen(void);
+
+// Old process: accepts one takeover request on control_fd. Returns the
+// requester's connection, or -1 if it was not a valid request.
+int handoff_accept(int control_fd);
+
+// Old process: passes server_fd over conn_fd and closes conn_fd. Returns 0 or -1.
+int handoff_send(int conn_fd, int server_fd);
+
+// Old process: waits (bounded) for exports still streaming to finish.
+void handoff_drain(void);
+
+// New process: asks a running server for its listening socket. Blocks
+// while the old process saves its snapshot. Returns the fd, or -1 if no
+// server answered.
+int handoff_request(void);
+
+#endif
@@ -3,104 +3,122 @@
 #include <string.h>
 #include <sqlite3.h>
 #include "home.h"
+#include "balance.h"
+#include "dates.h"
+#include "events.h"
+#include "http.h"
+#include "shard.h"
+#include "storage.h"
+#include "txlog.h"
 
 // ithu native json aa parase panna help pannuthu
 
-// e.g. body = "{ \"type\":\"expense\",\"amount\":\"123.45\",\"date\":\"2023-10-21\",\"category\":\"Food\" }"
-static void parse_body(const char *body, char *type, char *amount, char *date, char *category) {
-    // This is an extremely naive parsing approach.
-    const char *type_ptr = strstr(body, "\"type\":\"");
-    if (type_ptr) {
-        type_ptr += strlen("\"type\":\"");
-        sscanf(type_ptr, "%[^\"]", type);
+// "key":"value" la irunthu value-ai out-la copy pannuthu. Buffer-kku
+// perusaa irunthaa -1 (vetti store pannaama request-ai reject pannuvom).
+static int parse_field(const char *body, const char *pattern, char *out, size_t out_size) {
+    const char *ptr = strstr(body, pattern);
+    if (!ptr) {
+        return 0;
     }
-
-    const char *amount_ptr = strstr(body, "\"amount\":\"");
-    if (amount_ptr) {
-        amount_ptr += strlen("\"amount\":\"");
-        sscanf(amount_ptr, "%[^\"]", amount);
+    ptr += strlen(pattern);
+    size_t len = strcspn(ptr, "\"");
+    if (len >= out_size) {
+        return -1;
     }
+    memcpy(out, ptr, len);
+    out[len] = '\0';
+    return 0;
+}
 
-    const char *date_ptr = strstr(body, "\"date\":\"");
-    if (date_ptr) {
-        date_ptr += strlen("\"date\":\"");
-        sscanf(date_ptr, "%[^\"]", date);
+// e.g. body = "{ \"type\":\"expense\",\"amount\":\"123.45\",\"date\":\"2023-10-21\",\"category\":\"Food\",\"note\":\"Lunch\" }"
+// Returns -1 if any field is too long for its buffer.
+static int parse_body(const char *body, char *type, char *amount, char *date, char *category, char *note) {
+    // This is an extremely naive parsing approach.
+    if (parse_field(body, "\"type\":\"", type, 64) < 0 ||
+        parse_field(body, "\"amount\":\"", amount, 64) < 0 ||
+        parse_field(body, "\"date\":\"", date, 64) < 0 ||
+        parse_field(body, "\"category\":\"", category, 64) < 0) {
+        return -1;
     }
 
-    const char *cat_ptr = strstr(body, "\"category\":\"");
-    if (cat_ptr) {
-        cat_ptr += strlen("\"category\":\"");
-        sscanf(cat_ptr, "%[^\"]", category);
-    }
+    // note optional free text; 255 character-kku mela irunthaa reject
+    return parse_field(body, "\"note\":\"", note, 256);
 }
 
-//Database table illaddi atha add panna use aahuthu
-static int insert_into_db(const char *type, const char *amount, const char *date, const char *category, int user_id) {
-    sqlite3 *db;
-    char *err_msg = NULL;
+// User-in shard database-la transaction-ai add pannuthu
+static int insert_into_db(const char *type, const char *amount, const char *date, const char *category,
+                          const char *note, int user_id, int *out_id) {
+    sqlite3_stmt *stmt;
     int rc;
 
-    // 1. Database open pannuthu
-    rc = sqlite3_open("transactions.db", &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return rc;
+    // 1. User-ooda shard connection-ai eduthukkum (table shard_init-la create aahiduchu)
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        fprintf(stderr, "Shards are not initialised\n");
+        return SQLITE_ERROR;
     }
 
-    // 2. Table create pannuthu user_id ooda (primary key)
-    const char *create_table_sql =
-        "CREATE TABLE IF NOT EXISTS transactions ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    user_id INTEGER,"
-        "    trans_type TEXT,"
-        "    amount REAL,"
-        "    date TEXT,"
-        "    category TEXT,"
-        "    FOREIGN KEY(user_id) REFERENCES users(id)"
-        ");";
-
-    rc = sqlite3_exec(db, create_table_sql, NULL, NULL, &err_msg);
+    // 2. Transaction insert panrathukku aana code. Note free text-la ' irukkalaam,
+    //    athanaala values bind pannuthu. Search index trigger same transaction-la update aahum.
+    //    id ellaa shard-kkum pothuvaana sequence-la irunthu varuthu.
+    const char *sql_insert =
+        "INSERT INTO transactions (id, user_id, trans_type, amount, date, category, note) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+
+    long long id = shard_next_id(user_id);
+    rc = id < 0 ? SQLITE_ERROR : sqlite3_prepare_v2(db, sql_insert, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error creating table: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_close(db);
+        fprintf(stderr, "SQL insert error: %s\n", sqlite3_errmsg(db));
+        shard_release(user_id);
         return rc;
     }
 
-    // 3. Transaction insert panrathukku aana code
-    char sql_insert[512];
-    snprintf(sql_insert, sizeof(sql_insert),
-             "INSERT INTO transactions (user_id, trans_type, amount, date, category) "
-             "VALUES (%d, '%s', '%s', '%s', '%s');",
-             user_id, type, amount, date, category);
+    sqlite3_bind_int64(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_text(stmt, 3, type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, amount, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, category, -1, SQLITE_STATIC);
+    if (note[0]) {
+        sqlite3_bind_text(stmt, 7, note, -1, SQLITE_STATIC);
+    }
 
-    rc = sqlite3_exec(db, sql_insert, NULL, NULL, &err_msg);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL insert error: %s\n", err_msg);
-        sqlite3_free(err_msg);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+        rc = SQLITE_OK;
+        *out_id = (int)id;
+    } else {
+        fprintf(stderr, "SQL insert error: %s\n", sqlite3_errmsg(db));
     }
+    sqlite3_finalize(stmt);
 
-    // 4. database close pannuthu
-    sqlite3_close(db);
+    // 3. Shard-ai vidudhalai pannuthu (connection open-aave irukkum)
+    shard_release(user_id);
     return rc;
 }
 
+// 400 response, message body-la
+static char *bad_request_response(const char *message) {
+    char response[512];
+    snprintf(response, sizeof(response),
+        "HTTP/1.1 400 Bad Request\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+        "Access-Control-Allow-Headers: Content-Type\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: %zu\r\n"
+        "\r\n"
+        "%s",
+        strlen(message), message);
+    return strdup(response);
+}
+
 char *handle_home_request(const char *request, int user_id) {
     // 1. hhtp request la irunthu body ya conver pannuthu
     const char *body_start = strstr(request, "\r\n\r\n");
     if (!body_start) {
         // No body found
-        const char *response =
-            "HTTP/1.1 400 Bad Request\r\n"
-            "Access-Control-Allow-Origin: *\r\n"
-            "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
-            "Access-Control-Allow-Headers: Content-Type\r\n"
-            "Content-Type: text/plain\r\n"
-            "Content-Length: 12\r\n"
-            "\r\n"
-            "Bad Request";
-        return strdup(response);
+        return bad_request_response("Bad Request");
     }
     body_start += 4; // Move past "\r\n\r\n"
 
@@ -109,11 +127,40 @@ char *handle_home_request(const char *request, int user_id) {
     char amount[64] = {0};
     char date[64] = {0};
     char category[64] = {0};
+    char note[256] = {0};
+
+    if (parse_body(body_start, type, amount, date, category, note) < 0) {
+        return bad_request_response("Field too long (category 63, note 255 characters max)");
+    }
 
-    parse_body(body_start, type, amount, date, category);
+    // type income/expense mattum, date YYYY-MM-DD mattum; vera ethuvum
+    // store aagi /transactions, /events JSON-la raw-aa poga koodaathu
+    int day;
+    if ((strcmp(type, "income") != 0 && strcmp(type, "expense") != 0) ||
+        !http_is_date(date) || !date_to_day(date, &day)) {
+        return bad_request_response("type must be income or expense and date YYYY-MM-DD");
+    }
 
-    // 3. database la add panuthu user_id ooda
-    int rc = insert_into_db(type, amount, date, category, user_id);
+    // 3. database la add panuthu user_id ooda (--storage txlog aa irunthaa log la).
+    //    txlog record-la note-kku idam illai, category 35 character thaan;
+    //    athukku mela irunthaa vetti store pannaama reject pannuthu.
+    int rc;
+    int id = 0;
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        if (!txlog_fits(type, date, category, note)) {
+            return bad_request_response("With --storage txlog: no note, category 35 characters max");
+        }
+        rc = txlog_append(user_id, type, amount, date, category, &id) == 0 ? SQLITE_OK : SQLITE_ERROR;
+    } else {
+        rc = insert_into_db(type, amount, date, category, note, user_id, &id);
+    }
+
+    // Range report index build aahi irunthaa athaiyum update pannuthu,
+    // /events stream open-aa irunthaa puthu row-um monthly totals-um push pannuthu
+    if (rc == SQLITE_OK) {
+        balance_record(user_id, type, amount, date);
+        events_publish_transaction(user_id, id, type, strtod(amount, NULL), date, category, note);
+    }
 
     // 4. response build pannuthu
     if (rc == SQLITE_OK) {
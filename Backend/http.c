@@ -0,0 +1,176 @@
+/******************************************************************************
+ * http.c
+ *
+ * Small helpers shared by the route handlers: canned responses, query
+ * string parsing and blocking socket writes.
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "http.h"
+
+#define RESPONSE_BUFFER_SIZE 4096
+
+// Custom headers-udan response anuppum oru utility function
+void send_response(int socket_fd, const char *status, const char *content_type, const char *body) {
+    char response[RESPONSE_BUFFER_SIZE];
+    size_t body_len = strlen(body);
+
+    // Headers-ai format seydhu, body-ai thaniyaaga anuppum (body 4KB-ai vida periyadhaaga irukkalaam)
+    int header_len = snprintf(response, sizeof(response),
+        "%s\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+        "Access-Control-Allow-Headers: Content-Type\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "\r\n",
+        status, content_type, body_len);
+
+    if (http_write_all(socket_fd, response, (size_t)header_len) == 0) {
+        http_write_all(socket_fd, body, body_len);
+    }
+}
+
+// -------------------------------------------------------------------
+// HELPER: Value of a single hex digit, or -1.
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int http_query_param(const char *query, const char *key, char *out, size_t out_size)
+{
+    size_t key_len = strlen(key);
+    const char *p = query;
+
+    if (!p || out_size == 0) {
+        return 0;
+    }
+
+    while (*p) {
+        // 1) Find the end of this "name=value" pair
+        const char *pair_end = strchr(p, '&');
+        if (!pair_end) {
+            pair_end = p + strlen(p);
+        }
+
+        // 2) Compare the name, then decode the value into out
+        if ((size_t)(pair_end - p) >= key_len &&
+            strncmp(p, key, key_len) == 0 &&
+            (p[key_len] == '=' || p + key_len == pair_end)) {
+            const char *v = p + key_len;
+            if (*v == '=') {
+                v++;
+            }
+
+            size_t n = 0;
+            while (v < pair_end && n + 1 < out_size) {
+                if (*v == '+') {
+                    out[n++] = ' ';
+                    v++;
+                } else if (*v == '%' && pair_end - v >= 3 &&
+                           hex_value(v[1]) >= 0 && hex_value(v[2]) >= 0) {
+                    out[n++] = (char)(hex_value(v[1]) * 16 + hex_value(v[2]));
+                    v += 3;
+                } else {
+                    out[n++] = *v++;
+                }
+            }
+            out[n] = '\0';
+            return 1;
+        }
+
+        p = *pair_end ? pair_end + 1 : pair_end;
+    }
+
+    return 0;
+}
+
+int http_write_all(int socket_fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(socket_fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int http_body_field(const char *body, const char *key, char *out, size_t out_size)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+
+    const char *value = strstr(body, pattern);
+    if (!value || out_size == 0) {
+        return 0;
+    }
+    value += strlen(pattern);
+
+    size_t n = 0;
+    while (value[n] && value[n] != '"' && n + 1 < out_size) {
+        out[n] = value[n];
+        n++;
+    }
+    out[n] = '\0';
+    return 1;
+}
+
+void http_json_escape(const char *s, char *out, size_t out_size)
+{
+    size_t n = 0;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        char esc[8];
+        size_t len;
+
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)c;
+            len = 2;
+        } else if (c < 0x20) {
+            len = (size_t)snprintf(esc, sizeof(esc), "\\u%04x", c);
+        } else {
+            esc[0] = (char)c;
+            len = 1;
+        }
+
+        // Never split an escape sequence
+        if (n + len + 1 > out_size) {
+            break;
+        }
+        memcpy(out + n, esc, len);
+        n += len;
+    }
+    if (out_size > 0) {
+        out[n] = '\0';
+    }
+}
+
+int http_is_date(const char *s)
+{
+    // Expect exactly "YYYY-MM-DD"
+    for (int i = 0; i < 10; i++) {
+        if (i == 4 || i == 7) {
+            if (s[i] != '-') return 0;
+        } else if (!isdigit((unsigned char)s[i])) {
+            return 0;
+        }
+    }
+    return s[10] == '\0';
+}
@@ -0,0 +1,30 @@
+#ifndef HTTP_H
+#define HTTP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Sends a complete response with the usual CORS headers.
+// The socket is left open; the caller closes it.
+void send_response(int socket_fd, const char *status, const char *content_type, const char *body);
+
+// Copies the value of `key` from a raw query string ("a=1&b=2") into out.
+// Returns 1 if the key was present, 0 otherwise. '+' and %XX are decoded.
+int http_query_param(const char *query, const char *key, char *out, size_t out_size);
+
+// Copies the string value of "key" from a flat JSON request body
+// ({"key":"value",...}, no escapes) into out. Returns 1 if present.
+int http_body_field(const char *body, const char *key, char *out, size_t out_size);
+
+// Writes all len bytes to socket_fd, retrying on short writes and EINTR.
+// Blocks while the socket send buffer is full. Returns 0 or -1 on error.
+int http_write_all(int socket_fd, const char *data, size_t len);
+
+// Copies s into out as the body of a JSON string (quotes, backslashes and
+// control characters escaped), truncating to fit out_size.
+void http_json_escape(const char *s, char *out, size_t out_size);
+
+// Returns 1 if s is a "YYYY-MM-DD" date string, 0 otherwise.
+int http_is_date(const char *s);
+
+#endif
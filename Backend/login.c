@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,6 +6,54 @@
 
 #include "login.h"
 
+// Sameebathil login aana users-ai ninaivil vaikkum; thirumba login seyyum bodhu DB thirakka vendaam.
+// Main loop mattume login handle pannum, athanaala lock thevai illai.
+#define LOGIN_CACHE_SIZE 256
+
+struct login_entry {
+    char username[128];
+    char password[128];
+    int user_id;                // 0 = kaali slot
+    unsigned long last_used;
+};
+
+static struct login_entry g_login_cache[LOGIN_CACHE_SIZE];
+static unsigned long g_login_clock = 0;
+
+// Cache-il username/password porundhinaal user_id, illainaal 0
+static int login_cache_lookup(const char *username, const char *password) {
+    for (int i = 0; i < LOGIN_CACHE_SIZE; i++) {
+        struct login_entry *e = &g_login_cache[i];
+        if (e->user_id && strcmp(e->username, username) == 0) {
+            if (strcmp(e->password, password) != 0) {
+                return 0;
+            }
+            e->last_used = ++g_login_clock;
+            return e->user_id;
+        }
+    }
+    return 0;
+}
+
+// Cache-il podum; idam illainaal romba naal use aagaadha entry-ai maatrum
+static void login_cache_store(const char *username, const char *password, int user_id) {
+    struct login_entry *slot = NULL;
+    for (int i = 0; i < LOGIN_CACHE_SIZE; i++) {
+        struct login_entry *e = &g_login_cache[i];
+        if (e->user_id && strcmp(e->username, username) == 0) {
+            slot = e;
+            break;
+        }
+        if (!slot || (slot->user_id && (!e->user_id || e->last_used < slot->last_used))) {
+            slot = e;
+        }
+    }
+    snprintf(slot->username, sizeof(slot->username), "%s", username);
+    snprintf(slot->password, sizeof(slot->password), "%s", password);
+    slot->user_id = user_id;
+    slot->last_used = ++g_login_clock;
+}
+
 // Sadharana JSON-mathiri body parser. 
 // Request body-ai ethirpaarkum: { "username": "bob", "password": "secret" }
 static void parse_user_body(const char *body, char *username, char *password) {
@@ -128,6 +177,14 @@ char *handle_login_request(const char *request, int *outUserId) {
     char password[128] = {0};
     parse_user_body(body_start, username, password);
 
+    // Cache-il irundhaal DB thevai illai
+    *outUserId = login_cache_lookup(username, password);
+    if (*outUserId > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Login successful! Your user ID is %d.", *outUserId);
+        return strdup(msg);
+    }
+
     // 3. DB-a thirakkum
     sqlite3 *db;
     int rc = sqlite3_open("transactions.db", &db);
@@ -167,6 +224,7 @@ char *handle_login_request(const char *request, int *outUserId) {
     // 6. vetriyaga illainaal tholvi-yaga thiruppi kodukkum
     if (*outUserId > 0) {
         // Found the user
+        login_cache_store(username, password, *outUserId);
         char msg[128];
         snprintf(msg, sizeof(msg), "Login successful! Your user ID is %d.", *outUserId);
         return strdup(msg);
@@ -174,3 +232,69 @@ char *handle_login_request(const char *request, int *outUserId) {
         return strdup("Invalid username or password.");
     }
 }
+
+// Restart snapshot: cache-il ulla usernames mattum (romba naal use aagaadhathu mudhalil).
+// Passwords file-il poagaadhu; load seyyum bodhu DB-il irundhu thirumba edukkum.
+int login_snapshot_write(FILE *f) {
+    struct login_entry *order[LOGIN_CACHE_SIZE];
+    uint32_t count = 0;
+    for (int i = 0; i < LOGIN_CACHE_SIZE; i++) {
+        if (g_login_cache[i].user_id == 0) {
+            continue;
+        }
+        uint32_t j = count++;
+        while (j > 0 && order[j - 1]->last_used > g_login_cache[i].last_used) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = &g_login_cache[i];
+    }
+
+    if (fwrite(&count, sizeof(count), 1, f) != 1) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t len = (uint8_t)strlen(order[i]->username);
+        if (fwrite(&len, 1, 1, f) != 1 || fwrite(order[i]->username, 1, len, f) != len) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int login_snapshot_read(FILE *f) {
+    uint32_t count;
+    int loaded = 0;
+    if (fread(&count, sizeof(count), 1, f) != 1 || count > LOGIN_CACHE_SIZE) {
+        return -1;
+    }
+
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    if (sqlite3_open("transactions.db", &db) != SQLITE_OK || ensure_users_table(db) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "SELECT id, password FROM users WHERE username = ?;", -1, &stmt, NULL) != SQLITE_OK) {
+        sqlite3_close(db);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        char username[128];
+        uint8_t len;
+        if (fread(&len, 1, 1, f) != 1 || len >= sizeof(username) || fread(username, 1, len, f) != len) {
+            loaded = -1;
+            break;
+        }
+        username[len] = '\0';
+
+        sqlite3_bind_text(stmt, 1, username, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 1)) {
+            login_cache_store(username, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_int(stmt, 0));
+            loaded++;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return loaded;
+}
@@ -1,8 +1,15 @@
 #ifndef LOGIN_H
 #define LOGIN_H
 
+#include <stdio.h>
+
 char *handle_create_account_request(const char *request);
 
 char *handle_login_request(const char *request, int *outUserId);
 
+// Restart snapshot-kku login cache (see snapshot.h).
+// write: 0 / -1. read: load aana users ennikkai / -1.
+int login_snapshot_write(FILE *f);
+int login_snapshot_read(FILE *f);
+
 #endif
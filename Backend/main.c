@@ -2,78 +2,237 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 
+#include "http.h"         // http.c for send_response & query helpers
 #include "home.h"         // home.c for transaction insert route
 #include "login.h"        // login.c for login & create account
 #include "transactions.h" // transactions.c for fetching user transactions
+#include "export.h"       // export.c for streaming CSV/NDJSON exports
+#include "storage.h"      // storage.c for choosing sqlite / txlog engine
+#include "shard.h"        // shard.c for user_id -> database file mapping
+#include "balance.h"      // balance.c for arbitrary date-range totals
+#include "search.h"       // search.c for full-text transaction search
+#include "recurring.h"    // recurring.c for repeating transaction rules
+#include "events.h"       // events.c for GET /events live update streams
+#include "maintenance.h"  // maintenance.c for background checkpoints, ANALYZE & vacuum
+#include "admission.h"    // admission.c for rate limits, 429s & /metrics
+#include "handoff.h"      // handoff.c for --takeover listening-socket handoff
+#include "snapshot.h"     // snapshot.c for warm caches across a restart
 
 #define PORT 8080
 #define BUFFER_SIZE 4096
+#define READ_TIMEOUT_SEC 5
 
 // Log in anavar-in user_id-ai store seyyum
 static int g_logged_in_user_id = 0;
 
-// Custom headers-udan response anuppum oru utility function
-void send_response(int socket_fd, const char *status, const char *content_type, const char *body) {
-    char response[BUFFER_SIZE];
-
-    snprintf(response, sizeof(response),
-        "%s\r\n"
-        "Access-Control-Allow-Origin: *\r\n"
-        "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
-        "Access-Control-Allow-Headers: Content-Type\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "\r\n"
-        "%s",
-        status, content_type, strlen(body), body);
-
-    write(socket_fd, response, strlen(response));
+// --takeover-udan vandha puthu process-kku listening socket-ai koduthu, odikkondirukkum
+// exports mudiyum varai kaathirundhu veliyerum. Anuppa mudiyaavittaal -1 (pazhaiya padi thodarum).
+static int hand_over(int server_fd, int conn_fd, const char *storage_name) {
+    // Live streams puthu process-kku pogaathu; EventSource thaane reconnect seyyum
+    events_close_all();
+
+    // Maintenance thread-um athan connections-um puthu process-kku vazhi vidum
+    maintenance_stop();
+
+    // txlog-kku oru writer mattum: puthu process log-ai thirakkum munnaadiye moodanum
+    int txlog = storage_get_engine() == STORAGE_TXLOG;
+    if (txlog) {
+        handoff_drain();
+        storage_shutdown();
+    }
+
+    // Accept niruththiyaachu, ini ezhuthu illai - snapshot sariyaaga irukkum
+    if (snapshot_save(SNAPSHOT_PATH, g_logged_in_user_id) < 0 || handoff_send(conn_fd, server_fd) < 0) {
+        unlink(SNAPSHOT_PATH);
+        if (txlog && storage_init(storage_name) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        maintenance_start();
+        return -1;
+    }
+    printf("Listening socket handed over, draining...\n");
+
+    close(server_fd);
+    handoff_drain();
+    storage_shutdown();
+    shard_close();
+    exit(EXIT_SUCCESS);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     int server_fd, new_socket;
     struct sockaddr_in address;
     socklen_t addrlen = sizeof(address);
     char buffer[BUFFER_SIZE] = {0};
 
-    // 1. Socket-ai uruvaakkum
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("socket failed");
-        exit(EXIT_FAILURE);
+    // Command line: ./server [--storage sqlite|txlog] [--shards N] [--takeover] [--no-rate-limit]
+    const char *storage_name = "sqlite";
+    int shard_count = 1;
+    int takeover = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--storage") == 0 && i + 1 < argc) {
+            storage_name = argv[++i];
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            shard_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--takeover") == 0) {
+            takeover = 1;
+        } else if (strcmp(argv[i], "--no-rate-limit") == 0) {
+            admission_set_rate_limits(0);
+        } else {
+            fprintf(stderr, "Usage: %s [--storage sqlite|txlog] [--shards N] [--takeover] [--no-rate-limit]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
     }
 
-    // 2. Bind seyyum
-    memset(&address, 0, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    // Restart: odikkondirukkum server-idam irundhu listening socket-ai vaangum.
+    // Avan snapshot ezhudhi, storage-ai moodiya pinbu thaan socket varum.
+    server_fd = -1;
+    if (takeover) {
+        server_fd = handoff_request();
+        if (server_fd < 0) {
+            fprintf(stderr, "No running server to take over, starting cold\n");
+        }
+    }
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("bind failed");
-        close(server_fd);
+    if (shard_init(shard_count) < 0 || storage_init(storage_name) < 0) {
         exit(EXIT_FAILURE);
     }
 
-    // 3. Kaettukondiruppom (listen)
-    if (listen(server_fd, 5) < 0) {
-        perror("listen");
-        close(server_fd);
-        exit(EXIT_FAILURE);
+    // Client connection-ai moodinaal write() process-ai kolla koodathu
+    signal(SIGPIPE, SIG_IGN);
+
+    // Aayirakkanakkaana /events streams-kku fd limit-ai uyarththum
+    events_init();
+
+    // Checkpoint / ANALYZE / vacuum background-il; illaamal ponaalum server odum
+    if (maintenance_start() < 0) {
+        fprintf(stderr, "Maintenance thread not started, WAL checkpoints stay inline\n");
+    }
+
+    if (server_fd >= 0) {
+        // Caches-ai accept-kku munnaadiye nirappum; connections backlog-il kaathirukkum
+        snapshot_load(SNAPSHOT_PATH, &g_logged_in_user_id);
+    } else {
+        // 1. Socket-ai uruvaakkum
+        if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+            perror("socket failed");
+            exit(EXIT_FAILURE);
+        }
+
+        // Restart-kku pin TIME_WAIT port-ai thadukka koodathu
+        int reuse = 1;
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        // 2. Bind seyyum
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(PORT);
+
+        if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            perror("bind failed");
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
+
+        // 3. Kaettukondiruppom (listen). Burst-la vara connections queue-la kaathirukkum,
+        //    rate limit-ai thaandiyavai udane 429 vaangi poidum.
+        if (listen(server_fd, SOMAXCONN) < 0) {
+            perror("listen");
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
     }
 
-    printf("Server listening on port %d...\n", PORT);
+    // Adutha restart-kku control socket
+    int control_fd = handoff_listen();
+
+    // fd table full aana accept panna mudiyaathu, listening socket readable-aave
+    // irukkum; intha spare fd-ai close panni andha client-ai accept + close pannuvom
+    int spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    printf("Server listening on port %d (storage: %s, shards: %d)...\n", PORT, storage_name, shard_count);
 
     // 4. Main loop
     while (1) {
+        // Munthaiya request mudinjathu - athan latency maintenance-kku
+        maintenance_request_end();
+
+        // Client connection, takeover request alladhu adutha heartbeat varai kaathirukkum
+        struct pollfd fds[2] = { { server_fd, POLLIN, 0 }, { control_fd, POLLIN, 0 } };
+        if (poll(fds, control_fd >= 0 ? 2 : 1, events_poll_timeout()) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+        events_heartbeat();
+        if (control_fd >= 0 && (fds[1].revents & POLLIN)) {
+            int conn_fd = handoff_accept(control_fd);
+            if (conn_fd >= 0) {
+                close(control_fd);
+                control_fd = -1;
+                if (hand_over(server_fd, conn_fd, storage_name) < 0) {
+                    control_fd = handoff_listen();
+                }
+            }
+            continue;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        addrlen = sizeof(address);
         new_socket = accept(server_fd, (struct sockaddr *)&address, &addrlen);
         if (new_socket < 0) {
+            // fd theerndhuduchu: spare fd-ai vittu, pending client-ai 503 solli
+            // anuppuvom; illaati poll udane thirumba vanthu CPU 100% busy loop aagum
+            if (errno == EMFILE || errno == ENFILE) {
+                perror("accept");
+                if (spare_fd >= 0) {
+                    close(spare_fd);
+                    new_socket = accept(server_fd, NULL, NULL);
+                    if (new_socket >= 0) {
+                        send_response(new_socket, "HTTP/1.1 503 Service Unavailable", "text/plain", "Server busy");
+                        close(new_socket);
+                    }
+                    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                }
+                if (spare_fd < 0) {
+                    // Spare-um illai (system fd table full): konjam kaaththiru
+                    usleep(100 * 1000);
+                    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                }
+                continue;
+            }
+            // Client munnaadiye poyiruchu - server-ai niruththa vendaam
+            if (errno == EINTR || errno == ECONNABORTED) {
+                perror("accept");
+                continue;
+            }
             perror("accept");
             close(server_fd);
             exit(EXIT_FAILURE);
         }
 
+        // Per-IP token bucket: request-ai padikkum munnaadiye 429
+        if (!admission_check_client(address.sin_addr.s_addr)) {
+            admission_reject(new_socket);
+            continue;
+        }
+
+        // Mella anuppum client loop-ai pidichu vaikka koodathu
+        struct timeval read_timeout = { READ_TIMEOUT_SEC, 0 };
+        setsockopt(new_socket, SOL_SOCKET, SO_RCVTIMEO, &read_timeout, sizeof(read_timeout));
+
         // 5. Request-ai padikkum
         memset(buffer, 0, BUFFER_SIZE);
         ssize_t bytes_read = read(new_socket, buffer, BUFFER_SIZE - 1);
@@ -81,6 +240,7 @@ int main() {
             close(new_socket);
             continue;
         }
+        maintenance_request_begin();
 
         // Vandha HTTP request-ai print seyyum
         printf("Received request:\n%s\n", buffer);
@@ -90,6 +250,14 @@ int main() {
         char path[256] = {0};
         sscanf(buffer, "%s %s", method, path);
 
+        // Path-il irundhu query string-ai pirikkum (e.g. /transactions/export?format=csv)
+        const char *query = "";
+        char *query_start = strchr(path, '?');
+        if (query_start) {
+            *query_start = '\0';
+            query = query_start + 1;
+        }
+
         // 6. CORS kaga OPTIONS (preflight) request-ai handle seyyum
         if (strcmp(method, "OPTIONS") == 0) {
             send_response(new_socket, "HTTP/1.1 200 OK", "text/plain", "");
@@ -97,6 +265,14 @@ int main() {
             continue;
         }
 
+        // Login aana session-kkum oru token bucket (login / account create thavira)
+        if (g_logged_in_user_id != 0 &&
+            strcmp(path, "/login") != 0 && strcmp(path, "/create_account") != 0 &&
+            !admission_check_session(g_logged_in_user_id)) {
+            admission_reject(new_socket);
+            continue;
+        }
+
         // 7. Routing
         // Transaction insert seyyum
         if (strcmp(path, "/home") == 0 && strcmp(method, "POST") == 0) {
@@ -155,6 +331,186 @@ int main() {
             send_response(new_socket, "HTTP/1.1 200 OK", "application/json", transactions_json);
             free(transactions_json);
 
+        // Full history-ai CSV/NDJSON-aaga stream seyyum
+        } else if (strcmp(path, "/transactions/export") == 0 && strcmp(method, "GET") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            // Export thread socket-ai close seyyum (expensive slot-aiyum athuve edukkum)
+            start_transactions_export(new_socket, g_logged_in_user_id, query);
+            continue;
+
+        // Ethavathu date range-kku income/expense/balance
+        } else if (strcmp(path, "/reports/range") == 0 && strcmp(method, "GET") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            int bad_request = 0;
+            char *range_json = handle_range_report_request(g_logged_in_user_id, query, &bad_request);
+            send_response(new_socket, bad_request ? "HTTP/1.1 400 Bad Request" : "HTTP/1.1 200 OK",
+                          "application/json", range_json);
+            free(range_json);
+
+        // Category / note-la text thedi transactions-ai edukkum
+        } else if (strcmp(path, "/transactions/search") == 0 && strcmp(method, "GET") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            int status = 500;
+            char *search_json = handle_search_request(g_logged_in_user_id, query, &status);
+            if (!search_json) {
+                send_response(new_socket, "HTTP/1.1 500 Internal Server Error", "text/plain", "Out of memory\n");
+            } else {
+                send_response(new_socket,
+                              status == 400 ? "HTTP/1.1 400 Bad Request" :
+                              status == 500 ? "HTTP/1.1 500 Internal Server Error" :
+                              status == 501 ? "HTTP/1.1 501 Not Implemented" : "HTTP/1.1 200 OK",
+                              "application/json", search_json);
+            }
+            free(search_json);
+
+        // Repeat aagum transaction rule-ai save seyyum
+        } else if (strcmp(path, "/recurring") == 0 && strcmp(method, "POST") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            int bad_request = 0;
+            char *rule_json = handle_create_recurring_request(buffer, g_logged_in_user_id, &bad_request);
+            send_response(new_socket, bad_request ? "HTTP/1.1 400 Bad Request" : "HTTP/1.1 200 OK",
+                          "application/json", rule_json);
+            free(rule_json);
+
+        // User-oda recurring rules ellaam
+        } else if (strcmp(path, "/recurring") == 0 && strcmp(method, "GET") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            char *rules_json = handle_list_recurring_request(g_logged_in_user_id);
+            if (!rules_json) {
+                send_response(new_socket, "HTTP/1.1 500 Internal Server Error", "text/plain", "Out of memory\n");
+            } else {
+                send_response(new_socket, "HTTP/1.1 200 OK", "application/json", rules_json);
+            }
+            free(rules_json);
+
+        // Oru occurrence-ai mattum edit / delete seyyum
+        } else if (strcmp(path, "/recurring/occurrence") == 0 && strcmp(method, "POST") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            int bad_request = 0;
+            char *occurrence_json = handle_edit_occurrence_request(buffer, g_logged_in_user_id, &bad_request);
+            send_response(new_socket, bad_request ? "HTTP/1.1 400 Bad Request" : "HTTP/1.1 200 OK",
+                          "application/json", occurrence_json);
+            free(occurrence_json);
+
+        // Puthu transaction vanthaal push seyyum live stream (socket open-aave irukkum)
+        } else if (strcmp(path, "/events") == 0 && strcmp(method, "GET") == 0) {
+            if (g_logged_in_user_id == 0) {
+                send_response(new_socket, "HTTP/1.1 401 Unauthorized", "text/plain", "Please log in first.\n");
+                close(new_socket);
+                continue;
+            }
+
+            if (events_open(new_socket, g_logged_in_user_id) < 0) {
+                send_response(new_socket, "HTTP/1.1 503 Service Unavailable", "text/plain", "Too many open streams.\n");
+                close(new_socket);
+            }
+            continue;
+
+        // Maintenance jobs-ai paarkkum / odavaikkum - server machine-il irundhu mattum
+        } else if (strcmp(path, "/admin/maintenance") == 0) {
+            if (address.sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
+                send_response(new_socket, "HTTP/1.1 403 Forbidden", "text/plain", "Loopback only.\n");
+                close(new_socket);
+                continue;
+            }
+
+            // POST ?job=checkpoint|analyze|vacuum|vacuum_full queue seyyum; GET status mattum.
+            // vacuum_full shard-ai muzhusaa rewrite pannum, athu varai writes ellaam block
+            // aagum (p99 spike) - athanaala &force=1 kuduththaa mattum
+            char job[32] = "";
+            char force[8] = "";
+            int is_post = strcmp(method, "POST") == 0;
+            if (is_post && !http_query_param(query, "job", job, sizeof(job))) {
+                job[0] = '\0';
+            }
+            int blocking = strcmp(job, "vacuum_full") == 0;
+            if (is_post && blocking &&
+                (!http_query_param(query, "force", force, sizeof(force)) || strcmp(force, "1") != 0)) {
+                send_response(new_socket, "HTTP/1.1 400 Bad Request", "application/json",
+                              "{\"error\":\"vacuum_full blocks all writes to each shard while it is rewritten; "
+                              "add &force=1 to run it anyway\"}");
+                close(new_socket);
+                continue;
+            }
+            if (is_post && (!job[0] || maintenance_trigger(job) < 0)) {
+                send_response(new_socket, "HTTP/1.1 400 Bad Request", "application/json",
+                              "{\"error\":\"job must be checkpoint, analyze, vacuum or vacuum_full\"}");
+                close(new_socket);
+                continue;
+            }
+            char *status_json = maintenance_status();
+            char *body = status_json;
+            if (status_json && blocking) {
+                // 202-laye block aagum-nu solluthu
+                static const char warning[] =
+                    "{\"warning\":\"vacuum_full blocks all writes to each shard for as long as its rewrite "
+                    "takes\",\"status\":";
+                body = malloc(sizeof(warning) + strlen(status_json) + 1);
+                if (body) {
+                    sprintf(body, "%s%s}", warning, status_json);
+                }
+            }
+            send_response(new_socket, job[0] ? "HTTP/1.1 202 Accepted" : "HTTP/1.1 200 OK", "application/json",
+                          body ? body : "{\"error\":\"Out of memory\"}");
+            if (body != status_json) {
+                free(body);
+            }
+            free(status_json);
+
+        // Shed / admit counters, streams, maintenance timings (Prometheus text format)
+        } else if (strcmp(path, "/metrics") == 0 && strcmp(method, "GET") == 0) {
+            char *parts[] = { admission_metrics(), events_metrics(), maintenance_metrics() };
+            size_t needed = 1;
+            for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+                needed += parts[i] ? strlen(parts[i]) : 0;
+            }
+            char *metrics = malloc(needed);
+            if (metrics) {
+                metrics[0] = '\0';
+                for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+                    if (parts[i]) {
+                        strcat(metrics, parts[i]);
+                    }
+                }
+                send_response(new_socket, "HTTP/1.1 200 OK", "text/plain; version=0.0.4", metrics);
+            } else {
+                send_response(new_socket, "HTTP/1.1 500 Internal Server Error", "text/plain", "Out of memory\n");
+            }
+            for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+                free(parts[i]);
+            }
+            free(metrics);
+
         } else {
             // 404 Not Found
             send_response(new_socket, "HTTP/1.1 404 Not Found", "text/plain", "Not Found");
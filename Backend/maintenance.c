@@ -0,0 +1,632 @@
+/******************************************************************************
+ * maintenance.c
+ *
+ * Keeps the shard files in shape without showing up as request latency.
+ *
+ *   - checkpoint: shard writers no longer checkpoint inside a commit. Each
+ *     tick, a shard with new commits (PRAGMA data_version) gets a PASSIVE
+ *     checkpoint, which never blocks writers: every tick once the WAL
+ *     passes MAINT_WAL_SMALL_BYTES, at most every MAINT_CHECKPOINT_IDLE_SEC
+ *     below it. A TRUNCATE checkpoint gives the disk space back once writers
+ *     leave a big WAL alone, or when it passes MAINT_WAL_TRUNCATE_BYTES.
+ *   - analyze: PRAGMA optimize every MAINT_ANALYZE_SEC (a triggered run does
+ *     a plain ANALYZE), with analysis_limit so indexes are sampled rather
+ *     than scanned.
+ *   - vacuum: PRAGMA incremental_vacuum in steps sized to stay near
+ *     MAINT_STEP_BUDGET_MS, at most MAINT_VACUUM_SLICE_MS per tick, until the
+ *     freelist is empty. Needs auto_vacuum=INCREMENTAL, which new shards get
+ *     from shard.c; older files need one "vacuum_full" to switch.
+ *
+ * Every step that takes the write lock (TRUNCATE, ANALYZE, vacuum) first
+ * looks at the request latency the accept loop reports. While the recent
+ * average is well above the long-run baseline it sleeps, and after
+ * MAINT_MAX_YIELDS naps the job is deferred to a later tick.
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "maintenance.h"
+#include "shard.h"
+
+#define MAINT_TICK_MS               1000
+#define MAINT_BUSY_TIMEOUT_MS       50          // never queue long behind a writer
+#define MAINT_FIRST_RUN_SEC         60          // analyze / vacuum after startup
+#define MAINT_WAL_SMALL_BYTES       (4LL << 20) // below: checkpoint at most every ..._IDLE_SEC
+#define MAINT_WAL_TRUNCATE_BYTES    (64LL << 20)
+#define MAINT_CHECKPOINT_IDLE_SEC   30
+#define MAINT_ANALYZE_SEC           3600
+#define MAINT_ANALYSIS_LIMIT        1000
+#define MAINT_VACUUM_SEC            600
+#define MAINT_VACUUM_MIN_PAGES      256         // smaller freelists wait for a trigger
+#define MAINT_VACUUM_MAX_PAGES      4096
+#define MAINT_STEP_BUDGET_MS        10.0
+#define MAINT_VACUUM_SLICE_MS       200.0
+#define MAINT_STEP_GAP_US           5000        // lets a waiting writer in between steps
+#define MAINT_YIELD_MS              200
+#define MAINT_MAX_YIELDS            10
+#define MAINT_LATENCY_FLOOR_US      5000        // never "raised" below this
+#define MAINT_LATENCY_CEILING_US    100000      // always "raised" above this
+#define MAINT_QUIET_US              1000000     // no requests for this long = idle
+#define MAINT_WRITER_AUTOCHECKPOINT 1000        // SQLite's default, restored on stop
+
+enum maint_job {
+    JOB_CHECKPOINT,
+    JOB_ANALYZE,
+    JOB_VACUUM,
+    JOB_VACUUM_FULL,
+    JOB_COUNT
+};
+
+static const char *const g_job_names[JOB_COUNT] = { "checkpoint", "analyze", "vacuum", "vacuum_full" };
+
+struct job_stats {
+    unsigned long runs;
+    unsigned long steps;
+    unsigned long yields;
+    double total_ms;            // time inside steps
+    double last_ms;
+    double max_step_ms;         // the longest a request could wait behind this job
+    time_t last_run;            // 0 = never
+    const char *last_result;    // "ok", "busy", "error", "deferred"
+    time_t next_due;            // 0 = only when triggered
+    int pending;                // queued by maintenance_trigger()
+};
+
+struct maint_shard {
+    sqlite3 *db;                // the thread's own connection
+    char path[64];
+    int data_version;           // at the last checkpoint, -1 = never
+    time_t last_checkpoint;
+    int vacuum_pages;           // current incremental_vacuum step size
+    long long wal_bytes;        // figures for status / metrics
+    int freelist_pages;
+    int auto_vacuum;            // 0 none, 1 full, 2 incremental
+};
+
+static struct job_stats g_jobs[JOB_COUNT];
+static struct maint_shard g_shards[SHARD_MAX];
+static int g_shard_count = 0;
+
+static pthread_t g_thread;
+static int g_running = 0;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+
+// Request latency feedback, written by the accept loop only
+static atomic_llong g_request_start_us;     // 0 = no request running
+static atomic_llong g_request_end_us;
+static atomic_llong g_recent_us;            // EWMA over ~8 requests
+static atomic_llong g_baseline_us;          // EWMA over ~128 requests
+
+static long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static double elapsed_ms(long long start_us)
+{
+    return (now_us() - start_us) / 1000.0;
+}
+
+// First column of a one-row PRAGMA, or -1.
+static int pragma_int(sqlite3 *db, const char *sql)
+{
+    sqlite3_stmt *stmt;
+    int value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+static const char *result_of(int rc)
+{
+    return rc == SQLITE_OK ? "ok" : (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) ? "busy" : "error";
+}
+
+// -------------------------------------------------------------------
+// Backing off while requests are slow
+// -------------------------------------------------------------------
+static int latency_raised(void)
+{
+    long long now = now_us();
+    long long start = atomic_load(&g_request_start_us);
+    if (start && now - start > MAINT_LATENCY_CEILING_US) {
+        return 1;                                           // a slow request is running now
+    }
+    if (!start && now - atomic_load(&g_request_end_us) > MAINT_QUIET_US) {
+        return 0;                                           // idle: the averages are stale
+    }
+    long long recent = atomic_load(&g_recent_us);
+    long long baseline = atomic_load(&g_baseline_us);
+    return recent > MAINT_LATENCY_FLOOR_US &&
+           (recent > 2 * baseline || recent > MAINT_LATENCY_CEILING_US);
+}
+
+// Waits for latency to settle. Returns 0 to go ahead, -1 to defer the job.
+static int wait_for_quiet(enum maint_job job)
+{
+    for (int i = 0; i < MAINT_MAX_YIELDS; i++) {
+        if (!latency_raised()) {
+            return 0;
+        }
+        pthread_mutex_lock(&g_lock);
+        g_jobs[job].yields++;
+        int running = g_running;
+        pthread_mutex_unlock(&g_lock);
+        if (!running) {
+            return -1;
+        }
+        usleep(MAINT_YIELD_MS * 1000);
+    }
+    return -1;
+}
+
+// -------------------------------------------------------------------
+// Bookkeeping
+// -------------------------------------------------------------------
+static int take_due(enum maint_job job, int *triggered)
+{
+    pthread_mutex_lock(&g_lock);
+    struct job_stats *j = &g_jobs[job];
+    *triggered = j->pending;
+    int due = j->pending || (j->next_due && time(NULL) >= j->next_due);
+    pthread_mutex_unlock(&g_lock);
+    return due;
+}
+
+static void record_step(enum maint_job job, double ms)
+{
+    pthread_mutex_lock(&g_lock);
+    struct job_stats *j = &g_jobs[job];
+    j->steps++;
+    j->total_ms += ms;
+    if (ms > j->max_step_ms) {
+        j->max_step_ms = ms;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+// A deferred run stays due (and queued); others count and are rescheduled.
+static void record_run(enum maint_job job, double ms, const char *result, int next_in_sec)
+{
+    pthread_mutex_lock(&g_lock);
+    struct job_stats *j = &g_jobs[job];
+    j->last_result = result;
+    if (strcmp(result, "deferred") != 0) {
+        j->runs++;
+        j->last_ms = ms;
+        j->last_run = time(NULL);
+        j->pending = 0;
+        if (j->next_due) {
+            j->next_due = j->last_run + next_in_sec;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void refresh_figures(void)
+{
+    for (int s = 0; s < g_shard_count; s++) {
+        struct maint_shard *sh = &g_shards[s];
+        char wal_path[80];
+        struct stat st;
+        snprintf(wal_path, sizeof(wal_path), "%s-wal", sh->path);
+
+        long long wal_bytes = stat(wal_path, &st) == 0 ? (long long)st.st_size : 0;
+        int freelist = pragma_int(sh->db, "PRAGMA freelist_count;");
+        int auto_vacuum = pragma_int(sh->db, "PRAGMA auto_vacuum;");
+
+        pthread_mutex_lock(&g_lock);
+        sh->wal_bytes = wal_bytes;
+        sh->freelist_pages = freelist;
+        sh->auto_vacuum = auto_vacuum;
+        pthread_mutex_unlock(&g_lock);
+    }
+}
+
+// -------------------------------------------------------------------
+// Jobs (maintenance thread only)
+// -------------------------------------------------------------------
+static void run_checkpoints(int triggered)
+{
+    time_t now = time(NULL);
+    double total_ms = 0;
+    const char *result = "ok";
+    int ran = 0;
+
+    for (int s = 0; s < g_shard_count; s++) {
+        struct maint_shard *sh = &g_shards[s];
+        int version = pragma_int(sh->db, "PRAGMA data_version;");
+        int changed = version != sh->data_version;
+
+        // Shrink the file past the hard cap, or once writers leave a big WAL alone
+        int truncate = triggered || sh->wal_bytes >= MAINT_WAL_TRUNCATE_BYTES ||
+                       (!changed && sh->wal_bytes > MAINT_WAL_SMALL_BYTES);
+
+        if (!truncate) {
+            // Nothing committed since the last one, or a small WAL that can wait
+            int interval = sh->wal_bytes < MAINT_WAL_SMALL_BYTES ? MAINT_CHECKPOINT_IDLE_SEC : 0;
+            if (!changed || now - sh->last_checkpoint < interval) {
+                continue;
+            }
+        } else if (wait_for_quiet(JOB_CHECKPOINT) < 0) {
+            truncate = 0;               // TRUNCATE waits for writers; copy back only
+        }
+
+        long long t0 = now_us();
+        int rc = sqlite3_wal_checkpoint_v2(sh->db, NULL,
+                                           truncate ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE,
+                                           NULL, NULL);
+        double ms = elapsed_ms(t0);
+        record_step(JOB_CHECKPOINT, ms);
+        total_ms += ms;
+        ran = 1;
+        if (rc != SQLITE_OK) {
+            result = result_of(rc);
+        }
+        sh->data_version = version;
+        sh->last_checkpoint = now;
+    }
+
+    if (ran) {
+        record_run(JOB_CHECKPOINT, total_ms, result, 0);
+    }
+}
+
+static void run_analyze(int triggered)
+{
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA analysis_limit=%d; %s", MAINT_ANALYSIS_LIMIT,
+             triggered ? "ANALYZE;" : "PRAGMA optimize=0x10002;");
+    double total_ms = 0;
+    const char *result = "ok";
+
+    for (int s = 0; s < g_shard_count; s++) {
+        if (wait_for_quiet(JOB_ANALYZE) < 0) {
+            record_run(JOB_ANALYZE, total_ms, "deferred", 0);
+            return;
+        }
+        long long t0 = now_us();
+        int rc = sqlite3_exec(g_shards[s].db, sql, NULL, NULL, NULL);
+        double ms = elapsed_ms(t0);
+        record_step(JOB_ANALYZE, ms);
+        total_ms += ms;
+        if (rc != SQLITE_OK) {
+            result = result_of(rc);
+        }
+    }
+    record_run(JOB_ANALYZE, total_ms, result, MAINT_ANALYZE_SEC);
+}
+
+static void run_vacuum(int triggered)
+{
+    double slice_ms = 0;
+    const char *result = "ok";
+    int remaining = 0;
+
+    for (int s = 0; s < g_shard_count; s++) {
+        struct maint_shard *sh = &g_shards[s];
+        if (sh->auto_vacuum != 2) {
+            continue;
+        }
+        int free_pages = pragma_int(sh->db, "PRAGMA freelist_count;");
+        if (free_pages <= 0 || (!triggered && free_pages < MAINT_VACUUM_MIN_PAGES)) {
+            continue;
+        }
+
+        while (free_pages > 0 && slice_ms < MAINT_VACUUM_SLICE_MS) {
+            if (wait_for_quiet(JOB_VACUUM) < 0) {
+                record_run(JOB_VACUUM, slice_ms, "deferred", 0);
+                return;
+            }
+
+            char sql[64];
+            snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d);", sh->vacuum_pages);
+            long long t0 = now_us();
+            int rc = sqlite3_exec(sh->db, sql, NULL, NULL, NULL);
+            double ms = elapsed_ms(t0);
+            record_step(JOB_VACUUM, ms);
+            slice_ms += ms;
+            if (rc != SQLITE_OK) {
+                result = result_of(rc);
+                break;
+            }
+
+            // Size the next step so it stays near the budget
+            if (ms > MAINT_STEP_BUDGET_MS && sh->vacuum_pages > 1) {
+                sh->vacuum_pages /= 2;
+            } else if (ms < MAINT_STEP_BUDGET_MS / 4 && sh->vacuum_pages < MAINT_VACUUM_MAX_PAGES) {
+                sh->vacuum_pages *= 2;
+            }
+            free_pages = pragma_int(sh->db, "PRAGMA freelist_count;");
+            usleep(MAINT_STEP_GAP_US);
+        }
+        if (free_pages > 0) {
+            remaining = 1;
+        }
+    }
+
+    // Out of time with pages left: carry on next tick
+    record_run(JOB_VACUUM, slice_ms, result, remaining ? 1 : MAINT_VACUUM_SEC);
+}
+
+// One-off rewrite: blocks the shard's writer for as long as VACUUM takes.
+static void run_vacuum_full(void)
+{
+    double total_ms = 0;
+    const char *result = "ok";
+
+    for (int s = 0; s < g_shard_count; s++) {
+        if (wait_for_quiet(JOB_VACUUM_FULL) < 0) {
+            record_run(JOB_VACUUM_FULL, total_ms, "deferred", 0);
+            return;
+        }
+        long long t0 = now_us();
+        int rc = sqlite3_exec(g_shards[s].db, "PRAGMA auto_vacuum=INCREMENTAL; VACUUM;", NULL, NULL, NULL);
+        double ms = elapsed_ms(t0);
+        record_step(JOB_VACUUM_FULL, ms);
+        total_ms += ms;
+        if (rc != SQLITE_OK) {
+            result = result_of(rc);
+        }
+    }
+    record_run(JOB_VACUUM_FULL, total_ms, result, 0);
+}
+
+static void *maintenance_thread(void *arg)
+{
+    (void)arg;
+#if defined(__linux__)
+    // Linux keeps the nice value per thread: only maintenance is demoted
+    setpriority(PRIO_PROCESS, 0, 10);
+#endif
+
+    pthread_mutex_lock(&g_lock);
+    while (g_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += MAINT_TICK_MS % 1000 * 1000000L;
+        deadline.tv_sec += MAINT_TICK_MS / 1000 + deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&g_wake, &g_lock, &deadline);
+        if (!g_running) {
+            break;
+        }
+        pthread_mutex_unlock(&g_lock);
+
+        int triggered;
+        refresh_figures();
+        take_due(JOB_CHECKPOINT, &triggered);
+        run_checkpoints(triggered);
+        if (take_due(JOB_ANALYZE, &triggered)) {
+            run_analyze(triggered);
+        }
+        if (take_due(JOB_VACUUM, &triggered)) {
+            run_vacuum(triggered);
+        }
+        if (take_due(JOB_VACUUM_FULL, &triggered)) {
+            run_vacuum_full();
+        }
+
+        pthread_mutex_lock(&g_lock);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+int maintenance_start(void)
+{
+    if (g_running) {
+        return 0;
+    }
+
+    // 1) Own connections, so maintenance never holds a shard writer's lock
+    g_shard_count = shard_get_count();
+    for (int s = 0; s < g_shard_count; s++) {
+        struct maint_shard *sh = &g_shards[s];
+        memset(sh, 0, sizeof(*sh));
+        shard_path(s, sh->path, sizeof(sh->path));
+        if (sqlite3_open_v2(sh->path, &sh->db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+            fprintf(stderr, "maintenance: cannot open %s: %s\n", sh->path, sqlite3_errmsg(sh->db));
+            g_shard_count = s + 1;
+            maintenance_stop();
+            return -1;
+        }
+        sqlite3_busy_timeout(sh->db, MAINT_BUSY_TIMEOUT_MS);
+        sh->data_version = -1;          // checkpoint whatever WAL is already there
+        sh->vacuum_pages = 32;
+    }
+
+    // 2) Schedule, then start the thread
+    time_t now = time(NULL);
+    pthread_mutex_lock(&g_lock);
+    g_jobs[JOB_ANALYZE].next_due = now + MAINT_FIRST_RUN_SEC;
+    g_jobs[JOB_VACUUM].next_due = now + MAINT_FIRST_RUN_SEC;
+    g_running = 1;
+    pthread_mutex_unlock(&g_lock);
+    if (pthread_create(&g_thread, NULL, maintenance_thread, NULL) != 0) {
+        perror("maintenance pthread_create");
+        g_running = 0;
+        maintenance_stop();
+        return -1;
+    }
+
+    // 3) Commits stop paying for checkpoints
+    shard_set_wal_autocheckpoint(0);
+    return 0;
+}
+
+void maintenance_stop(void)
+{
+    if (g_running) {
+        pthread_mutex_lock(&g_lock);
+        g_running = 0;
+        pthread_cond_signal(&g_wake);
+        pthread_mutex_unlock(&g_lock);
+        pthread_join(g_thread, NULL);
+        shard_set_wal_autocheckpoint(MAINT_WRITER_AUTOCHECKPOINT);
+    }
+
+    for (int s = 0; s < g_shard_count; s++) {
+        sqlite3_close(g_shards[s].db);
+        g_shards[s].db = NULL;
+    }
+    g_shard_count = 0;
+}
+
+void maintenance_request_begin(void)
+{
+    atomic_store(&g_request_start_us, now_us());
+}
+
+void maintenance_request_end(void)
+{
+    long long start = atomic_exchange(&g_request_start_us, 0);
+    if (start == 0) {
+        return;
+    }
+    long long end = now_us();
+    long long latency = end - start;
+    long long recent = atomic_load(&g_recent_us);
+    long long baseline = atomic_load(&g_baseline_us);
+    atomic_store(&g_recent_us, recent + (latency - recent) / 8);
+    atomic_store(&g_baseline_us, baseline ? baseline + (latency - baseline) / 128 : latency);
+    atomic_store(&g_request_end_us, end);
+}
+
+int maintenance_trigger(const char *job)
+{
+    for (int j = 0; j < JOB_COUNT; j++) {
+        if (strcmp(job, g_job_names[j]) == 0) {
+            pthread_mutex_lock(&g_lock);
+            g_jobs[j].pending = 1;
+            pthread_cond_signal(&g_wake);
+            pthread_mutex_unlock(&g_lock);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+char *maintenance_status(void)
+{
+    static const char *const auto_vacuum_names[] = { "none", "full", "incremental" };
+    size_t size = 4096 + (size_t)SHARD_MAX * 128;
+    char *json = malloc(size);
+    if (!json) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_lock);
+    size_t len = snprintf(json, size,
+                          "{\"running\":%s,\"latency_ms\":{\"recent\":%.2f,\"baseline\":%.2f},\"jobs\":[",
+                          g_running ? "true" : "false",
+                          atomic_load(&g_recent_us) / 1000.0, atomic_load(&g_baseline_us) / 1000.0);
+
+    for (int j = 0; j < JOB_COUNT && len < size; j++) {
+        const struct job_stats *job = &g_jobs[j];
+        char last_run[32] = "null";
+        char next_due[32] = "null";
+        if (job->last_run) {
+            struct tm tm;
+            gmtime_r(&job->last_run, &tm);
+            strftime(last_run, sizeof(last_run), "\"%Y-%m-%dT%H:%M:%SZ\"", &tm);
+        }
+        if (job->next_due) {
+            snprintf(next_due, sizeof(next_due), "%ld", (long)(job->next_due - time(NULL)));
+        }
+        len += snprintf(json + len, size - len,
+                        "%s{\"job\":\"%s\",\"pending\":%s,\"runs\":%lu,\"steps\":%lu,\"yields\":%lu,"
+                        "\"last_run\":%s,\"last_result\":%s%s%s,\"last_ms\":%.2f,\"max_step_ms\":%.2f,"
+                        "\"total_ms\":%.2f,\"next_due_sec\":%s}",
+                        j ? "," : "", g_job_names[j], job->pending ? "true" : "false",
+                        job->runs, job->steps, job->yields, last_run,
+                        job->last_result ? "\"" : "", job->last_result ? job->last_result : "null",
+                        job->last_result ? "\"" : "",
+                        job->last_ms, job->max_step_ms, job->total_ms, next_due);
+    }
+    if (len < size) {
+        len += snprintf(json + len, size - len, "],\"shards\":[");
+    }
+    for (int s = 0; s < g_shard_count && len < size; s++) {
+        const struct maint_shard *sh = &g_shards[s];
+        len += snprintf(json + len, size - len,
+                        "%s{\"shard\":%d,\"wal_bytes\":%lld,\"freelist_pages\":%d,\"auto_vacuum\":\"%s\"}",
+                        s ? "," : "", s, sh->wal_bytes, sh->freelist_pages,
+                        sh->auto_vacuum >= 0 && sh->auto_vacuum <= 2 ? auto_vacuum_names[sh->auto_vacuum] : "unknown");
+    }
+    if (len < size) {
+        snprintf(json + len, size - len, "]}");
+    }
+    pthread_mutex_unlock(&g_lock);
+    return json;
+}
+
+char *maintenance_metrics(void)
+{
+    static const char *const families[][3] = {
+        { "maintenance_runs_total", "counter", "Finished maintenance job runs." },
+        { "maintenance_steps_total", "counter", "Maintenance steps (one checkpoint, ANALYZE or vacuum call each)." },
+        { "maintenance_step_seconds_total", "counter", "Time spent inside maintenance steps." },
+        { "maintenance_step_max_seconds", "gauge", "Longest single step: the most a request could wait behind maintenance." },
+        { "maintenance_yields_total", "counter", "Naps taken because request latency was raised." },
+    };
+    size_t size = 4096 + (size_t)SHARD_MAX * 64;
+    char *text = malloc(size);
+    if (!text) {
+        return NULL;
+    }
+    size_t len = 0;
+    text[0] = '\0';
+
+    pthread_mutex_lock(&g_lock);
+    for (size_t f = 0; f < sizeof(families) / sizeof(families[0]) && len < size; f++) {
+        len += snprintf(text + len, size - len, "# HELP %s %s\n# TYPE %s %s\n",
+                        families[f][0], families[f][2], families[f][0], families[f][1]);
+        for (int j = 0; j < JOB_COUNT && len < size; j++) {
+            const struct job_stats *job = &g_jobs[j];
+            double values[] = { job->runs, job->steps, job->total_ms / 1000.0, job->max_step_ms / 1000.0, job->yields };
+            len += snprintf(text + len, size - len, "%s{job=\"%s\"} %g\n",
+                            families[f][0], g_job_names[j], values[f]);
+        }
+    }
+    if (len < size) {
+        len += snprintf(text + len, size - len,
+                        "# HELP shard_wal_bytes Size of each shard's write-ahead log file.\n"
+                        "# TYPE shard_wal_bytes gauge\n");
+    }
+    for (int s = 0; s < g_shard_count && len < size; s++) {
+        len += snprintf(text + len, size - len, "shard_wal_bytes{shard=\"%d\"} %lld\n", s, g_shards[s].wal_bytes);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    if (len < size) {
+        snprintf(text + len, size - len,
+                 "# HELP request_latency_recent_seconds Recent request latency (EWMA) maintenance backs off on.\n"
+                 "# TYPE request_latency_recent_seconds gauge\n"
+                 "request_latency_recent_seconds %.6f\n"
+                 "# HELP request_latency_baseline_seconds Long-run request latency (EWMA).\n"
+                 "# TYPE request_latency_baseline_seconds gauge\n"
+                 "request_latency_baseline_seconds %.6f\n",
+                 atomic_load(&g_recent_us) / 1e6, atomic_load(&g_baseline_us) / 1e6);
+    }
+    return text;
+}
@@ -0,0 +1,34 @@
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+// Background upkeep of the shard databases: WAL checkpoints, planner
+// statistics and incremental vacuum, run on a low-priority thread with its
+// own connections. Work is split into small timed steps, and steps that
+// would block writers wait while request latency is above its baseline.
+
+// Starts the thread (after shard_init) and takes automatic checkpoints off
+// the shard writers. Returns 0, or -1 if the thread could not start.
+int maintenance_start(void);
+
+// Stops the thread and gives checkpoints back to the shard writers.
+void maintenance_stop(void);
+
+// Called by the accept loop around each request: the latency feedback
+// that makes maintenance back off.
+void maintenance_request_begin(void);
+void maintenance_request_end(void);
+
+// Queues a run of "checkpoint", "analyze", "vacuum" or "vacuum_full"
+// (one-off rewrite that enables incremental vacuum on an older file; it
+// blocks each shard's writes for the whole rewrite, so POST
+// /admin/maintenance only queues it with force=1).
+// Returns 0, or -1 for an unknown job.
+int maintenance_trigger(const char *job);
+
+// GET /admin/maintenance: job state and per-shard figures as JSON (malloc'd).
+char *maintenance_status(void);
+
+// Job timings in Prometheus text format for GET /metrics (malloc'd).
+char *maintenance_metrics(void);
+
+#endif
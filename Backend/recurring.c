@@ -0,0 +1,780 @@
+/******************************************************************************
+ * recurring.c
+ *
+ * Recurring transactions (rent, salary, subscriptions) stored as one rule
+ * row in the user's shard instead of one row per month.
+ *
+ *   - Readers expand rules on the fly: the transaction list merges the
+ *     occurrences into its date order, get_monthly_totals() adds per-month
+ *     counts times the amount, and the range index (balance.c) adds
+ *     amount x recurring_count_between() for the queried range.
+ *   - Counts are closed form for every unit. Monthly buckets only count
+ *     the twelve months they show (the latest year of each month), found
+ *     by walking back from today about one step per month, never from
+ *     the rule's start. Nothing is read or stored per occurrence.
+ *   - Editing or deleting one occurrence writes a real transaction (unless
+ *     deleted) and adds the date to the rule's `skipped` list in the same
+ *     SQLite transaction, so totals always equal the materialized data.
+ *
+ * Rules live in SQLite for both storage engines; with --storage txlog the
+ * edited occurrence is appended to the log after the skip is committed
+ * and the skip is undone if the append fails.
+ ******************************************************************************/
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sqlite3.h>
+
+#include "recurring.h"
+#include "balance.h"
+#include "dates.h"
+#include "events.h"
+#include "http.h"
+#include "shard.h"
+#include "storage.h"
+#include "txlog.h"
+
+#define RECURRING_NO_END     INT_MAX
+#define RECURRING_MAX_EVERY  1000
+
+#define RULE_COLUMNS \
+    "id, trans_type, amount, category, note, start_date, unit, every, end_date, skipped"
+
+static const char *const g_unit_names[] = { "day", "week", "month", "year" };
+
+int recurring_today(void)
+{
+    return (int)(time(NULL) / 86400);
+}
+
+// -------------------------------------------------------------------
+// HELPER: "day"/"week"/"month"/"year" -> enum. Returns 0 if unknown.
+static int parse_unit(const char *name, enum recurring_unit *out)
+{
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, g_unit_names[i]) == 0) {
+            *out = (enum recurring_unit)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static void copy_text(char *out, size_t out_size, const unsigned char *text)
+{
+    snprintf(out, out_size, "%s", text ? (const char *)text : "");
+}
+
+// -------------------------------------------------------------------
+// HELPER: Fill a rule from a row selected with RULE_COLUMNS.
+// Returns -1 for rows that cannot be expanded (bad dates or unit), -2
+// when out of memory.
+static int fill_rule(struct recurring_rule *rule, sqlite3_stmt *stmt)
+{
+    memset(rule, 0, sizeof(*rule));
+    rule->id = sqlite3_column_int(stmt, 0);
+    copy_text(rule->trans_type, sizeof(rule->trans_type), sqlite3_column_text(stmt, 1));
+    rule->is_income = strcmp(rule->trans_type, "income") == 0 ? 1
+                    : strcmp(rule->trans_type, "expense") == 0 ? 0 : -1;
+    rule->amount = sqlite3_column_double(stmt, 2);
+    copy_text(rule->category, sizeof(rule->category), sqlite3_column_text(stmt, 3));
+    copy_text(rule->note, sizeof(rule->note), sqlite3_column_text(stmt, 4));
+    rule->every = sqlite3_column_int(stmt, 7);
+
+    const unsigned char *start = sqlite3_column_text(stmt, 5);
+    const unsigned char *unit = sqlite3_column_text(stmt, 6);
+    const unsigned char *end = sqlite3_column_text(stmt, 8);
+    if (!start || !date_to_day((const char *)start, &rule->start_day) ||
+        !unit || !parse_unit((const char *)unit, &rule->unit) || rule->every < 1) {
+        return -1;
+    }
+    rule->end_day = RECURRING_NO_END;
+    if (end && !date_to_day((const char *)end, &rule->end_day)) {
+        return -1;
+    }
+
+    // "2025-01-31,2025-03-31" -> sorted day numbers
+    const char *skipped = (const char *)sqlite3_column_text(stmt, 9);
+    if (skipped && skipped[0]) {
+        size_t max = 1;
+        for (const char *p = skipped; *p; p++) {
+            max += *p == ',';
+        }
+        rule->skipped = malloc(max * sizeof(int));
+        if (!rule->skipped) {
+            return -2;
+        }
+        for (const char *p = skipped; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+            char date[11];
+            int day;
+            snprintf(date, sizeof(date), "%.10s", p);
+            if (date_to_day(date, &day)) {
+                rule->skipped[rule->skipped_count++] = day;
+            }
+        }
+        qsort(rule->skipped, rule->skipped_count, sizeof(int), compare_int);
+    }
+    return 0;
+}
+
+int recurring_load(int user_id, struct recurring_rule **out)
+{
+    sqlite3_stmt *stmt;
+    struct recurring_rule *rules = NULL;
+    int count = 0, cap = 0;
+
+    *out = NULL;
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        return -1;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT " RULE_COLUMNS " FROM recurring_rules WHERE user_id = ? ORDER BY id;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement (recurring): %s\n", sqlite3_errmsg(db));
+        shard_release(user_id);
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+
+    // A rule missing for lack of memory would silently change every total
+    int failed = 0;
+    while (!failed && sqlite3_step(stmt) == SQLITE_ROW) {
+        if (count == cap) {
+            cap = cap ? cap * 2 : 8;
+            struct recurring_rule *grown = realloc(rules, (size_t)cap * sizeof(*grown));
+            if (!grown) {
+                failed = 1;
+                break;
+            }
+            rules = grown;
+        }
+        int rc = fill_rule(&rules[count], stmt);
+        if (rc == 0) {
+            count++;
+        } else {
+            free(rules[count].skipped);
+            failed = rc == -2;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    shard_release(user_id);
+    if (failed) {
+        recurring_free(rules, count);
+        return -1;
+    }
+    *out = rules;
+    return count;
+}
+
+void recurring_free(struct recurring_rule *rules, int count)
+{
+    for (int i = 0; i < count; i++) {
+        free(rules[i].skipped);
+    }
+    free(rules);
+}
+
+// -------------------------------------------------------------------
+// Occurrence arithmetic
+// -------------------------------------------------------------------
+static int step_days(const struct recurring_rule *rule)
+{
+    return rule->unit == RECURRING_WEEK ? 7 * rule->every : rule->every;
+}
+
+static int step_months(const struct recurring_rule *rule)
+{
+    return rule->unit == RECURRING_YEAR ? 12 * rule->every : rule->every;
+}
+
+static int is_skipped(const struct recurring_rule *rule, int day)
+{
+    return rule->skipped_count > 0 &&
+           bsearch(&day, rule->skipped, rule->skipped_count, sizeof(int), compare_int) != NULL;
+}
+
+int recurring_occurrence_day(const struct recurring_rule *rule, int n)
+{
+    if (rule->unit == RECURRING_DAY || rule->unit == RECURRING_WEEK) {
+        return rule->start_day + n * step_days(rule);
+    }
+
+    int y, m, d;
+    day_to_civil(rule->start_day, &y, &m, &d);
+    long months = (long)y * 12 + (m - 1) + (long)n * step_months(rule);
+    y = (int)(months / 12);
+    m = (int)(months % 12) + 1;
+    int dim = days_in_month(y, m);
+    return days_from_civil(y, m, d < dim ? d : dim);
+}
+
+int recurring_count_through(const struct recurring_rule *rule, int day)
+{
+    int limit = day < rule->end_day ? day : rule->end_day;
+    if (limit < rule->start_day) {
+        return 0;
+    }
+    if (rule->unit == RECURRING_DAY || rule->unit == RECURRING_WEEK) {
+        return (limit - rule->start_day) / step_days(rule) + 1;
+    }
+
+    // Last step landing in limit's month or earlier; its clamped day may
+    // still be after limit
+    int sy, sm, sd, ly, lm, ld;
+    day_to_civil(rule->start_day, &sy, &sm, &sd);
+    day_to_civil(limit, &ly, &lm, &ld);
+    int n = ((ly * 12 + lm) - (sy * 12 + sm)) / step_months(rule);
+    if (recurring_occurrence_day(rule, n) > limit) {
+        n--;
+    }
+    return n + 1;
+}
+
+// Skipped days in [from_day, to_day]: two binary searches on the sorted list
+static int skipped_between(const struct recurring_rule *rule, int from_day, int to_day)
+{
+    size_t lo = 0, hi = rule->skipped_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (rule->skipped[mid] < from_day) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    size_t first = lo;
+    hi = rule->skipped_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (rule->skipped[mid] <= to_day) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)(lo - first);
+}
+
+int recurring_count_between(const struct recurring_rule *rule, int from_day, int to_day)
+{
+    if (to_day > rule->end_day) {
+        to_day = rule->end_day;
+    }
+    if (from_day > to_day) {
+        return 0;
+    }
+    int before = from_day <= rule->start_day ? 0 : recurring_count_through(rule, from_day - 1);
+    return recurring_count_through(rule, to_day) - before - skipped_between(rule, from_day, to_day);
+}
+
+void recurring_for_each(const struct recurring_rule *rule, int from_day, int to_day,
+                        void (*visit)(const struct recurring_rule *rule, int day, void *ctx),
+                        void *ctx)
+{
+    int first = from_day <= rule->start_day ? 0 : recurring_count_through(rule, from_day - 1);
+    int last = recurring_count_through(rule, to_day);
+    for (int n = first; n < last; n++) {
+        int day = recurring_occurrence_day(rule, n);
+        if (!is_skipped(rule, day)) {
+            visit(rule, day, ctx);
+        }
+    }
+}
+
+// -------------------------------------------------------------------
+// List expansion
+// -------------------------------------------------------------------
+struct collect_ctx {
+    struct recurring_occurrence *items;
+    int count;
+    int cap;
+    int rule_index;
+    int failed;
+};
+
+static void collect_visit(const struct recurring_rule *rule, int day, void *arg)
+{
+    struct collect_ctx *ctx = arg;
+    (void)rule;
+    if (ctx->count == ctx->cap) {
+        int cap = ctx->cap ? ctx->cap * 2 : 64;
+        struct recurring_occurrence *grown = realloc(ctx->items, (size_t)cap * sizeof(*grown));
+        if (!grown) {
+            ctx->failed = 1;
+            return;
+        }
+        ctx->items = grown;
+        ctx->cap = cap;
+    }
+    ctx->items[ctx->count].day = day;
+    ctx->items[ctx->count].rule_index = ctx->rule_index;
+    ctx->count++;
+}
+
+// Newest first; same day ordered by rule so the list is stable
+static int compare_occurrence_desc(const void *a, const void *b)
+{
+    const struct recurring_occurrence *x = a, *y = b;
+    if (x->day != y->day) {
+        return x->day < y->day ? 1 : -1;
+    }
+    return (x->rule_index < y->rule_index) - (x->rule_index > y->rule_index);
+}
+
+int recurring_collect(const struct recurring_rule *rules, int count, int through_day,
+                      struct recurring_occurrence **out)
+{
+    struct collect_ctx ctx = { 0 };
+    for (int i = 0; i < count && !ctx.failed; i++) {
+        ctx.rule_index = i;
+        recurring_for_each(&rules[i], rules[i].start_day, through_day, collect_visit, &ctx);
+    }
+    if (ctx.failed) {
+        free(ctx.items);
+        *out = NULL;
+        return -1;
+    }
+    qsort(ctx.items, (size_t)ctx.count, sizeof(*ctx.items), compare_occurrence_desc);
+    *out = ctx.items;
+    return ctx.count;
+}
+
+// -------------------------------------------------------------------
+// Aggregation: occurrences per month of year, without enumerating them
+// -------------------------------------------------------------------
+static void month_span(int y, int m, int *first_day, int *last_day)
+{
+    *first_day = days_from_civil(y, m, 1);
+    *last_day = *first_day + days_in_month(y, m) - 1;
+}
+
+// Raises year[m] to the latest year in which rule has a live occurrence in
+// month m, on or before through_day. Walks back one occurrence month at a
+// time, jumping over the days in between, and stops once every month of
+// the year is found; month/year steps repeat their months every 12
+// occurrences, so they also stop after 12 plus the skipped ones.
+static void latest_years(const struct recurring_rule *rule, int through_day, int year[12])
+{
+    int found = 0, visited = 0;
+    int month_steps = rule->unit == RECURRING_MONTH || rule->unit == RECURRING_YEAR;
+    int n = recurring_count_through(rule, through_day);
+    while (n > 0 && found != 0xfff) {
+        if (month_steps && visited++ >= 12 + (int)rule->skipped_count) {
+            break;
+        }
+        int y, m, d, first, last;
+        day_to_civil(recurring_occurrence_day(rule, n - 1), &y, &m, &d);
+        month_span(y, m, &first, &last);
+        if (!(found & (1 << (m - 1))) && recurring_count_between(rule, first, last) > 0) {
+            found |= 1 << (m - 1);
+            if (y > year[m - 1]) {
+                year[m - 1] = y;
+            }
+        }
+        n = recurring_count_through(rule, first - 1);
+    }
+}
+
+int recurring_monthly_totals(int user_id, double expenses[12], double income[12],
+                             int expense_year[12], int income_year[12])
+{
+    struct recurring_rule *rules;
+    int count = recurring_load(user_id, &rules);
+    if (count < 0) {
+        return -1;
+    }
+
+    // 1) Year each bucket ends up showing: stored rows or occurrences,
+    //    whichever is later. A later year replaces the stored sum.
+    int today = recurring_today();
+    int year[2][12];
+    memcpy(year[0], expense_year, sizeof(year[0]));
+    memcpy(year[1], income_year, sizeof(year[1]));
+    for (int i = 0; i < count; i++) {
+        if (rules[i].is_income >= 0) {
+            latest_years(&rules[i], today, year[rules[i].is_income]);
+        }
+    }
+    for (int m = 0; m < 12; m++) {
+        if (year[0][m] != expense_year[m]) {
+            expenses[m] = 0;
+            expense_year[m] = year[0][m];
+        }
+        if (year[1][m] != income_year[m]) {
+            income[m] = 0;
+            income_year[m] = year[1][m];
+        }
+    }
+
+    // 2) Each rule's live occurrences in those twelve months
+    for (int i = 0; i < count; i++) {
+        const struct recurring_rule *rule = &rules[i];
+        if (rule->is_income < 0) {
+            continue;
+        }
+        double *bucket = rule->is_income ? income : expenses;
+        for (int m = 0; m < 12; m++) {
+            int y = year[rule->is_income][m];
+            int first, last;
+            if (y == RECURRING_NO_YEAR) {
+                continue;
+            }
+            month_span(y, m + 1, &first, &last);
+            bucket[m] += recurring_count_between(rule, first, last < today ? last : today) * rule->amount;
+        }
+    }
+
+    recurring_free(rules, count);
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Route handlers
+// -------------------------------------------------------------------
+
+// HELPER: Positive amount with nothing after the number.
+static int parse_amount(const char *s, double *out)
+{
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0' || !isfinite(v) || v <= 0) {
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+char *handle_create_recurring_request(const char *request, int user_id, int *bad_request)
+{
+    char type[16] = "", amount_str[32] = "", category[64] = "", note[256] = "";
+    char start[16] = "", unit_str[8] = "month", every_str[8] = "1", end[16] = "";
+    double amount;
+    enum recurring_unit unit;
+    int start_day, end_day = RECURRING_NO_END;
+
+    // 1) Body fields
+    *bad_request = 1;
+    const char *body = strstr(request, "\r\n\r\n");
+    if (!body) {
+        return strdup("{\"error\":\"No body found\"}");
+    }
+    body += 4;
+    http_body_field(body, "type", type, sizeof(type));
+    http_body_field(body, "amount", amount_str, sizeof(amount_str));
+    http_body_field(body, "category", category, sizeof(category));
+    http_body_field(body, "note", note, sizeof(note));
+    http_body_field(body, "start", start, sizeof(start));
+    http_body_field(body, "unit", unit_str, sizeof(unit_str));
+    http_body_field(body, "every", every_str, sizeof(every_str));
+    http_body_field(body, "end", end, sizeof(end));
+
+    // 2) Validate
+    int every = atoi(every_str);
+    if (strcmp(type, "income") != 0 && strcmp(type, "expense") != 0) {
+        return strdup("{\"error\":\"type must be income or expense\"}");
+    }
+    if (!parse_amount(amount_str, &amount)) {
+        return strdup("{\"error\":\"amount must be a positive number\"}");
+    }
+    if (!http_is_date(start) || !date_to_day(start, &start_day) ||
+        (end[0] && (!http_is_date(end) || !date_to_day(end, &end_day) || end_day < start_day))) {
+        return strdup("{\"error\":\"start/end must be YYYY-MM-DD with end >= start\"}");
+    }
+    if (!parse_unit(unit_str, &unit) || every < 1 || every > RECURRING_MAX_EVERY) {
+        return strdup("{\"error\":\"unit must be day, week, month or year and every 1..1000\"}");
+    }
+    *bad_request = 0;
+
+    // 3) One row, however long the rule runs
+    sqlite3_stmt *stmt;
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        return strdup("{\"error\":\"Cannot open database\"}");
+    }
+    long long id = shard_next_id(user_id);
+    int rc = id < 0 ? SQLITE_ERROR : sqlite3_prepare_v2(db,
+        "INSERT INTO recurring_rules (id, user_id, trans_type, amount, category, note, start_date, unit, every, end_date) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, id);
+        sqlite3_bind_int(stmt, 2, user_id);
+        sqlite3_bind_text(stmt, 3, type, -1, SQLITE_STATIC);
+        sqlite3_bind_double(stmt, 4, amount);
+        sqlite3_bind_text(stmt, 5, category, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 6, note, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 7, start, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 8, g_unit_names[unit], -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 9, every);
+        if (end[0]) {
+            sqlite3_bind_text(stmt, 10, end, -1, SQLITE_STATIC);
+        }
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_finalize(stmt);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL insert error (recurring): %s\n", sqlite3_errmsg(db));
+        shard_release(user_id);
+        return strdup("{\"error\":\"Cannot save rule\"}");
+    }
+    shard_release(user_id);
+
+    // Range index keeps a copy of the rules; rebuild it with this one
+    balance_invalidate(user_id);
+    events_publish_recurring(user_id);
+
+    char json[64];
+    snprintf(json, sizeof(json), "{\"id\":%lld}", id);
+    return strdup(json);
+}
+
+char *handle_list_recurring_request(int user_id)
+{
+    struct recurring_rule *rules;
+    int count = recurring_load(user_id, &rules);
+    if (count < 0) {
+        return strdup("{\"error\":\"Cannot load rules\"}");
+    }
+
+    size_t cap = 16;
+    for (int i = 0; i < count; i++) {
+        cap += 2304 + rules[i].skipped_count * 16;
+    }
+    char *json = malloc(cap);
+    if (!json) {
+        recurring_free(rules, count);
+        return NULL;
+    }
+    size_t len = (size_t)snprintf(json, cap, "[");
+
+    for (int i = 0; i < count; i++) {
+        const struct recurring_rule *r = &rules[i];
+        char type_esc[64], category_esc[256], note_esc[1536], start[16], end[16] = "";
+        http_json_escape(r->trans_type, type_esc, sizeof(type_esc));
+        http_json_escape(r->category, category_esc, sizeof(category_esc));
+        http_json_escape(r->note, note_esc, sizeof(note_esc));
+        day_to_date(r->start_day, start, sizeof(start));
+        if (r->end_day != RECURRING_NO_END) {
+            day_to_date(r->end_day, end, sizeof(end));
+        }
+
+        len += (size_t)snprintf(json + len, cap - len,
+            "%s{\"id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,\"category\":\"%s\",\"note\":\"%s\","
+            "\"start\":\"%s\",\"unit\":\"%s\",\"every\":%d,\"end\":%s%s%s,\"skipped\":[",
+            i ? "," : "", r->id, type_esc, r->amount, category_esc, note_esc,
+            start, g_unit_names[r->unit], r->every,
+            end[0] ? "\"" : "", end[0] ? end : "null", end[0] ? "\"" : "");
+        for (size_t s = 0; s < r->skipped_count; s++) {
+            char date[16];
+            day_to_date(r->skipped[s], date, sizeof(date));
+            len += (size_t)snprintf(json + len, cap - len, "%s\"%s\"", s ? "," : "", date);
+        }
+        len += (size_t)snprintf(json + len, cap - len, "]}");
+    }
+    snprintf(json + len, cap - len, "]");
+
+    recurring_free(rules, count);
+    return json;
+}
+
+// HELPER: Load one rule of user_id by id. Returns 0 if found.
+static int load_rule(sqlite3 *db, int user_id, int rule_id, struct recurring_rule *out)
+{
+    sqlite3_stmt *stmt;
+    int rc = -1;
+    if (sqlite3_prepare_v2(db, "SELECT " RULE_COLUMNS " FROM recurring_rules WHERE id = ? AND user_id = ?;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, rule_id);
+    sqlite3_bind_int(stmt, 2, user_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        rc = fill_rule(out, stmt);
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// HELPER: Add or remove date in the rule's skipped list.
+static int update_skipped(sqlite3 *db, int rule_id, const char *date, int add)
+{
+    sqlite3_stmt *stmt;
+    const char *sql = add
+        ? "UPDATE recurring_rules SET skipped = CASE WHEN skipped = '' THEN ?1 ELSE skipped || ',' || ?1 END "
+          "WHERE id = ?2;"
+        : "UPDATE recurring_rules SET skipped = trim(replace(',' || skipped || ',', ',' || ?1 || ',', ','), ',') "
+          "WHERE id = ?2;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, date, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, rule_id);
+    int rc = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// HELPER: The real row that replaces an edited occurrence (sqlite engine).
+static int insert_occurrence_row(sqlite3 *db, long long id, int user_id, const char *type,
+                                 const char *amount, const char *date, const char *category,
+                                 const char *note)
+{
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,
+            "INSERT INTO transactions (id, user_id, trans_type, amount, date, category, note) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?);", -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_text(stmt, 3, type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, amount, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, category, -1, SQLITE_STATIC);
+    if (note[0]) {
+        sqlite3_bind_text(stmt, 7, note, -1, SQLITE_STATIC);
+    }
+    int rc = sqlite3_step(stmt) == SQLITE_DONE ? 0 : -1;
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+char *handle_edit_occurrence_request(const char *request, int user_id, int *bad_request)
+{
+    char rule_id_str[16] = "", date[16] = "", delete_str[8] = "";
+    char type[16] = "", amount_str[32] = "", category[64] = "", note[256] = "";
+    int has_type, has_amount, has_category, has_note;
+    struct recurring_rule rule;
+    double amount = 0;
+    int day;
+
+    // 1) Body fields
+    *bad_request = 1;
+    const char *body = strstr(request, "\r\n\r\n");
+    if (!body) {
+        return strdup("{\"error\":\"No body found\"}");
+    }
+    body += 4;
+    http_body_field(body, "rule_id", rule_id_str, sizeof(rule_id_str));
+    http_body_field(body, "date", date, sizeof(date));
+    http_body_field(body, "delete", delete_str, sizeof(delete_str));
+    has_type = http_body_field(body, "type", type, sizeof(type)) && type[0];
+    has_amount = http_body_field(body, "amount", amount_str, sizeof(amount_str)) && amount_str[0];
+    has_category = http_body_field(body, "category", category, sizeof(category));
+    has_note = http_body_field(body, "note", note, sizeof(note));
+    int remove = strcmp(delete_str, "true") == 0;
+
+    if (!http_is_date(date) || !date_to_day(date, &day)) {
+        return strdup("{\"error\":\"date must be YYYY-MM-DD\"}");
+    }
+    if ((has_type && strcmp(type, "income") != 0 && strcmp(type, "expense") != 0) ||
+        (has_amount && !parse_amount(amount_str, &amount))) {
+        return strdup("{\"error\":\"type must be income or expense and amount a positive number\"}");
+    }
+
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        *bad_request = 0;
+        return strdup("{\"error\":\"Cannot open database\"}");
+    }
+
+    // 2) The date must be a live occurrence of one of the user's rules
+    if (load_rule(db, user_id, atoi(rule_id_str), &rule) < 0) {
+        shard_release(user_id);
+        return strdup("{\"error\":\"No such recurring rule\"}");
+    }
+    int n = recurring_count_through(&rule, day);
+    if (n == 0 || recurring_occurrence_day(&rule, n - 1) != day || is_skipped(&rule, day)) {
+        free(rule.skipped);
+        shard_release(user_id);
+        return strdup("{\"error\":\"date is not an occurrence of this rule\"}");
+    }
+    *bad_request = 0;
+
+    // 3) Values of the materialized row: the rule's unless overridden
+    char amount_text[32];
+    snprintf(amount_text, sizeof(amount_text), "%.2f", has_amount ? amount : rule.amount);
+    const char *row_type = has_type ? type : rule.trans_type;
+    const char *row_category = has_category ? category : rule.category;
+    const char *row_note = has_note ? note : rule.note;
+    long long transaction_id = 0;
+    int rc;
+
+    // A log record has no note and a short category: refuse rather than
+    // materialize a cut-down copy of the occurrence
+    if (storage_get_engine() == STORAGE_TXLOG && !remove &&
+        !txlog_fits(row_type, date, row_category, row_note)) {
+        free(rule.skipped);
+        shard_release(user_id);
+        *bad_request = 1;
+        return strdup("{\"error\":\"with --storage txlog an edited occurrence needs an empty note "
+                      "and a category of at most 35 characters\"}");
+    }
+
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        // Skip first; undo it if the log refuses the row
+        rc = update_skipped(db, rule.id, date, 1);
+        if (rc == 0 && !remove) {
+            int id = 0;
+            rc = txlog_append(user_id, row_type, amount_text, date, row_category, &id);
+            if (rc < 0) {
+                if (update_skipped(db, rule.id, date, 0) < 0) {
+                    fprintf(stderr, "Rule %d: could not undo skip of %s: %s\n", rule.id, date, sqlite3_errmsg(db));
+                }
+            } else {
+                transaction_id = id;
+            }
+        }
+    } else {
+        // Skip and row commit together. The id is reserved first: a block
+        // reservation writes transactions.db, which BEGIN IMMEDIATE on
+        // shard 0 would hold locked.
+        if (!remove) {
+            transaction_id = shard_next_id(user_id);
+        }
+        rc = remove || transaction_id >= 0 ? 0 : -1;
+        if (rc == 0) {
+            rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK ? 0 : -1;
+            if (rc == 0) {
+                rc = update_skipped(db, rule.id, date, 1);
+                if (rc == 0 && !remove) {
+                    rc = insert_occurrence_row(db, transaction_id, user_id, row_type, amount_text,
+                                               date, row_category, row_note);
+                }
+                if (sqlite3_exec(db, rc == 0 ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL) != SQLITE_OK) {
+                    rc = -1;
+                }
+            }
+        }
+    }
+    if (rc < 0) {
+        fprintf(stderr, "Editing occurrence %s of rule %d failed: %s\n", date, rule.id, sqlite3_errmsg(db));
+    }
+    free(rule.skipped);
+    shard_release(user_id);
+
+    if (rc < 0) {
+        return strdup("{\"error\":\"Cannot save occurrence\"}");
+    }
+    balance_invalidate(user_id);
+    events_publish_recurring(user_id);
+
+    char json[128];
+    if (remove) {
+        snprintf(json, sizeof(json), "{\"rule_id\":%d,\"date\":\"%s\",\"transaction_id\":null}", rule.id, date);
+    } else {
+        snprintf(json, sizeof(json), "{\"rule_id\":%d,\"date\":\"%s\",\"transaction_id\":%lld}",
+                 rule.id, date, transaction_id);
+    }
+    return strdup(json);
+}
@@ -0,0 +1,93 @@
+#ifndef RECURRING_H
+#define RECURRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recurring transactions: one rule row stands for every occurrence from
+// start_day on, every `every` units, until end_day. Occurrences are
+// expanded at query time up to today; editing a single occurrence turns it
+// into a real transaction row and records its date in the rule's skip list.
+
+enum recurring_unit {
+    RECURRING_DAY,
+    RECURRING_WEEK,
+    RECURRING_MONTH,
+    RECURRING_YEAR
+};
+
+struct recurring_rule {
+    int id;
+    int is_income;              // 1 income, 0 expense, -1 any other type
+    char trans_type[16];
+    double amount;
+    char category[64];
+    char note[256];
+    int start_day;              // day numbers, see dates.h
+    int end_day;                // last day an occurrence may fall on
+    enum recurring_unit unit;
+    int every;
+    int *skipped;               // sorted occurrence days replaced by real rows
+    size_t skipped_count;
+};
+
+// Today's day number (UTC): rules are expanded up to and including it.
+int recurring_today(void);
+
+// Loads user_id's rules (malloc'd array, release with recurring_free).
+// Returns the number of rules, or -1 on a database error or when out of memory.
+int recurring_load(int user_id, struct recurring_rule **out);
+void recurring_free(struct recurring_rule *rules, int count);
+
+// Day of occurrence n (0-based). Month and year steps keep the start's day
+// of month, clamped to shorter months (Jan 31 -> Feb 28 -> Mar 31).
+int recurring_occurrence_day(const struct recurring_rule *rule, int n);
+
+// Number of occurrences on or before day, skipped ones included.
+int recurring_count_through(const struct recurring_rule *rule, int day);
+
+// Occurrences in [from_day, to_day] not replaced by real rows, without
+// enumerating them.
+int recurring_count_between(const struct recurring_rule *rule, int from_day, int to_day);
+
+// Calls visit for each occurrence in [from_day, to_day] that was not
+// replaced by a real row, in date order.
+void recurring_for_each(const struct recurring_rule *rule, int from_day, int to_day,
+                        void (*visit)(const struct recurring_rule *rule, int day, void *ctx),
+                        void *ctx);
+
+// One expanded occurrence: rules[rule_index] on day.
+struct recurring_occurrence {
+    int day;
+    int rule_index;
+};
+
+// Every occurrence of rules up to through_day, newest first (malloc'd).
+// Returns the count, or -1 when out of memory.
+int recurring_collect(const struct recurring_rule *rules, int count, int through_day,
+                      struct recurring_occurrence **out);
+
+// Month bucket without any rows (see recurring_monthly_totals)
+#define RECURRING_NO_YEAR INT32_MIN
+
+// Merges user_id's occurrences up to today into the per-month sums that
+// get_monthly_totals() fills (index 0 = January): each bucket holds the
+// most recent year with a row or live occurrence in that month, and
+// *_year[m] is that year (RECURRING_NO_YEAR if none) on entry and exit.
+// Occurrences are counted in closed form for just those months; finding
+// them takes about 12 steps per rule (one per occurrence for day/week
+// steps longer than a month, until all 12 months are found).
+int recurring_monthly_totals(int user_id, double expenses[12], double income[12],
+                             int expense_year[12], int income_year[12]);
+
+// POST /recurring  {"type","amount","category","note","start","unit","every","end"}
+// GET  /recurring
+// POST /recurring/occurrence  {"rule_id","date", optional "type","amount",
+//                              "category","note", or "delete":"true"}
+// Return malloc'd JSON bodies (the list returns NULL when out of memory);
+// *bad_request is set to 1 for invalid input.
+char *handle_create_recurring_request(const char *request, int user_id, int *bad_request);
+char *handle_list_recurring_request(int user_id);
+char *handle_edit_occurrence_request(const char *request, int user_id, int *bad_request);
+
+#endif
@@ -0,0 +1,187 @@
+/******************************************************************************
+ * search.c
+ *
+ * GET /transactions/search: full-text search over category and note using
+ * the transactions_fts table that shard_ensure_schema() keeps in step with
+ * transactions through triggers (same commit as the row itself).
+ *
+ *   - Every word of q is matched as a prefix ("gro" finds "Groceries"),
+ *     and all words must match somewhere in category or note.
+ *   - The fts row carries an "owner" column (u<user_id>) so the user
+ *     filter is part of the MATCH instead of a scan over other users' hits.
+ *   - Ranked by bm25 with category weighted above note, newest first
+ *     among equal ranks; paged with page/limit.
+ ******************************************************************************/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+
+#include "search.h"
+#include "http.h"
+#include "shard.h"
+#include "storage.h"
+
+#define SEARCH_MAX_QUERY      256
+#define SEARCH_MAX_TERMS      8
+#define SEARCH_DEFAULT_LIMIT  20
+#define SEARCH_MAX_LIMIT      100
+#define SEARCH_ROW_SIZE       2304    // fits one row of the escaped buffers below
+
+// -------------------------------------------------------------------
+// HELPER: Build the FTS5 MATCH expression for q. Words are split on
+// anything that is not a letter or digit (bytes >= 0x80 are kept so
+// UTF-8 words survive), then quoted and prefix-matched. Returns the
+// number of words used; 0 means nothing searchable was given.
+static int build_match(int user_id, const char *q, char *out, size_t out_size)
+{
+    int terms = 0;
+    size_t n = (size_t)snprintf(out, out_size, "owner : \"u%d\" AND {category note} : (", user_id);
+
+    while (*q && terms < SEARCH_MAX_TERMS) {
+        // 1) Skip separators
+        while (*q && !isalnum((unsigned char)*q) && (unsigned char)*q < 0x80) {
+            q++;
+        }
+        const char *start = q;
+        while (*q && (isalnum((unsigned char)*q) || (unsigned char)*q >= 0x80)) {
+            q++;
+        }
+        if (q == start) {
+            break;
+        }
+
+        // 2) "word"* - the quotes keep words like AND/OR/NEAR literal
+        int len = (int)(q - start);
+        int written = snprintf(out + n, out_size - n, "%s\"%.*s\"*",
+                               terms ? " AND " : "", len, start);
+        if (written < 0 || n + (size_t)written + 2 > out_size) {
+            break;
+        }
+        n += (size_t)written;
+        terms++;
+    }
+
+    snprintf(out + n, out_size - n, ")");
+    return terms;
+}
+
+// -------------------------------------------------------------------
+// HELPER: Parse a positive integer query parameter. Missing or empty
+// keeps *value; returns 0 if the value is not a number in [1, max].
+static int query_int(const char *query, const char *key, int max, int *value)
+{
+    char buf[16];
+    if (!http_query_param(query, key, buf, sizeof(buf)) || buf[0] == '\0') {
+        return 1;
+    }
+    char *end;
+    long v = strtol(buf, &end, 10);
+    if (*end != '\0' || v < 1 || v > max) {
+        return 0;
+    }
+    *value = (int)v;
+    return 1;
+}
+
+char *handle_search_request(int user_id, const char *query, int *status)
+{
+    char q[SEARCH_MAX_QUERY];
+    char match[SEARCH_MAX_QUERY * 2 + 128];
+    int page = 1;
+    int limit = SEARCH_DEFAULT_LIMIT;
+
+    // 1) Validate the request. The txlog engine has no index to search:
+    //    that is the server's configuration, not a bad request
+    if (storage_get_engine() != STORAGE_SQLITE) {
+        *status = 501;
+        return strdup("{\"error\":\"Search is not available with --storage txlog\"}");
+    }
+    *status = 400;
+    if (!query_int(query, "page", 100000, &page) ||
+        !query_int(query, "limit", SEARCH_MAX_LIMIT, &limit)) {
+        return strdup("{\"error\":\"page and limit must be positive integers (limit <= 100)\"}");
+    }
+    if (!http_query_param(query, "q", q, sizeof(q)) ||
+        build_match(user_id, q, match, sizeof(match)) == 0) {
+        return strdup("{\"error\":\"q must contain at least one word\"}");
+    }
+    *status = 500;
+
+    // 2) Ranked page of matches; one extra row tells us if there is more
+    sqlite3 *db = shard_acquire(user_id);
+    if (!db) {
+        return strdup("{\"error\":\"Cannot open database\"}");
+    }
+
+    const char *sql =
+        "SELECT t.id, t.trans_type, t.amount, t.date, t.category, t.note "
+        "FROM transactions_fts f JOIN transactions t ON t.id = f.rowid "
+        "WHERE transactions_fts MATCH ?1 "
+        "ORDER BY bm25(transactions_fts, 0.0, 2.0, 1.0), t.date DESC, t.id DESC "
+        "LIMIT ?2 OFFSET ?3;";
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Search prepare failed: %s\n", sqlite3_errmsg(db));
+        shard_release(user_id);
+        return strdup("{\"error\":\"Search failed\"}");
+    }
+    sqlite3_bind_text(stmt, 1, match, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, limit + 1);
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64)(page - 1) * limit);
+
+    // 3) Results array (rows are bounded, so size the buffer once)
+    size_t cap = (size_t)limit * SEARCH_ROW_SIZE + 2 * sizeof(q) + 256;
+    char *json = malloc(cap);
+    if (!json) {
+        sqlite3_finalize(stmt);
+        shard_release(user_id);
+        return NULL;
+    }
+    char escaped_q[sizeof(q) * 2];
+    http_json_escape(q, escaped_q, sizeof(escaped_q));
+    size_t len = (size_t)snprintf(json, cap, "{\"query\":\"%s\",\"page\":%d,\"limit\":%d,\"results\":[",
+                                  escaped_q, page, limit);
+
+    int rows = 0;
+    int has_more = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (rows == limit) {
+            has_more = 1;
+            break;
+        }
+        const char *type = (const char *)sqlite3_column_text(stmt, 1);
+        const char *date = (const char *)sqlite3_column_text(stmt, 3);
+        const char *category = (const char *)sqlite3_column_text(stmt, 4);
+        const char *note = (const char *)sqlite3_column_text(stmt, 5);
+        char type_esc[128], date_esc[128], category_esc[256], note_esc[1536];
+        http_json_escape(type ? type : "", type_esc, sizeof(type_esc));
+        http_json_escape(date ? date : "", date_esc, sizeof(date_esc));
+        http_json_escape(category ? category : "", category_esc, sizeof(category_esc));
+        http_json_escape(note ? note : "", note_esc, sizeof(note_esc));
+
+        len += (size_t)snprintf(json + len, cap - len,
+            "%s{\"id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,\"date\":\"%s\",\"category\":\"%s\",\"note\":\"%s\"}",
+            rows ? "," : "",
+            sqlite3_column_int(stmt, 0), type_esc, sqlite3_column_double(stmt, 2),
+            date_esc, category_esc, note_esc);
+        rows++;
+    }
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        // A partial page would look complete with has_more:false
+        fprintf(stderr, "Search failed: %s\n", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        shard_release(user_id);
+        free(json);
+        return strdup("{\"error\":\"Search failed\"}");
+    }
+    sqlite3_finalize(stmt);
+    shard_release(user_id);
+
+    *status = 200;
+    snprintf(json + len, cap - len, "],\"has_more\":%s}", has_more ? "true" : "false");
+    return json;
+}
@@ -0,0 +1,12 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// GET /transactions/search?q=...&page=N&limit=M
+// Full-text prefix search over the user's categories and notes, best
+// matches first. Returns a malloc'd JSON body (NULL when out of memory)
+// and sets *status to the HTTP status: 400 for a missing query or bad
+// paging values, 501 when the storage engine has no index, 500 when the
+// database fails.
+char *handle_search_request(int user_id, const char *query, int *status);
+
+#endif
@@ -0,0 +1,636 @@
+/******************************************************************************
+ * shard.c
+ *
+ * Maps user_id -> SQLite shard file and owns one long-lived writer
+ * connection per shard. Every shard has its own database-level write lock,
+ * so inserts for users on different shards no longer contend.
+ *
+ * A user's rows never span shards, so every per-user query runs against a
+ * single connection. The shard count is recorded in transactions.db
+ * (table shard_meta) so the server cannot start with a layout that does
+ * not match the files on disk.
+ *
+ * Transaction and recurring rule ids come from one sequence in shard_meta
+ * ("next_id"), so an id names the same row whichever shard holds it and
+ * rows keep their ids when shard_rebalance moves them. Each shard writer
+ * reserves SHARD_ID_BLOCK ids at a time; ids left in a block at shutdown
+ * are simply skipped.
+ *
+ * The server still runs requests one at a time on its accept loop, so the
+ * per-shard locks only let writes overlap for callers on their own threads
+ * (export and maintenance readers, bench/shard_bench.c). They do not raise
+ * the server's insert throughput by themselves.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#include "shard.h"
+
+// Columns copied when rows move between shards (id is handled separately)
+#define SHARD_TRANSACTION_COLUMNS "user_id, trans_type, amount, date, category, note"
+#define SHARD_RECURRING_COLUMNS \
+    "user_id, trans_type, amount, category, note, start_date, unit, every, end_date, skipped"
+
+#define SHARD_ID_BLOCK 1024
+
+struct shard {
+    sqlite3 *db;
+    pthread_mutex_t lock;
+    long long next_id;          // reserved ids [next_id, id_limit), under lock
+    long long id_limit;
+};
+
+static struct shard g_shards[SHARD_MAX];
+static int g_shard_count = 0;
+
+// Own connection to transactions.db for id reservations, so a reservation
+// never joins a transaction open on shard 0's writer
+static sqlite3 *g_sequence_db = NULL;
+static pthread_mutex_t g_sequence_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int shard_of_user(int user_id, int count)
+{
+    // Murmur3 finaliser: consecutive ids land on different shards
+    uint32_t h = (uint32_t)user_id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (int)(h % (uint32_t)count);
+}
+
+void shard_path(int index, char *out, size_t out_size)
+{
+    if (index == 0) {
+        snprintf(out, out_size, "transactions.db");
+    } else {
+        snprintf(out, out_size, "transactions-shard-%02d.db", index);
+    }
+}
+
+void shard_path_for_user(int user_id, char *out, size_t out_size)
+{
+    int count = g_shard_count > 0 ? g_shard_count : 1;
+    shard_path(shard_of_user(user_id, count), out, out_size);
+}
+
+int shard_get_count(void)
+{
+    return g_shard_count;
+}
+
+// -------------------------------------------------------------------
+// HELPER: 1 if `table` has a column called `column`.
+static int has_column(sqlite3 *db, const char *table, const char *column)
+{
+    sqlite3_stmt *stmt;
+    int found = 0;
+    char *sql = sqlite3_mprintf("SELECT 1 FROM pragma_table_info(%Q) WHERE name = %Q;", table, column);
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+        found = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_free(sql);
+    return found;
+}
+
+// HELPER: 1 if a table (or virtual table) called `table` exists.
+static int has_table(sqlite3 *db, const char *table)
+{
+    sqlite3_stmt *stmt;
+    int found = 0;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE name = ?;", -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+        found = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    return found;
+}
+
+int shard_ensure_schema(sqlite3 *db)
+{
+    // ids are assigned by shard_next_id(); AUTOINCREMENT only matters for
+    // rows inserted by hand
+    const char *schema_sql =
+        "CREATE TABLE IF NOT EXISTS transactions ("
+        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    user_id INTEGER,"
+        "    trans_type TEXT,"
+        "    amount REAL,"
+        "    date TEXT,"
+        "    category TEXT,"
+        "    note TEXT,"
+        "    FOREIGN KEY(user_id) REFERENCES users(id)"
+        ");"
+        "CREATE INDEX IF NOT EXISTS idx_transactions_user_date "
+        "    ON transactions(user_id, date);"
+        // Recurring rules (recurring.c): expanded at query time. skipped
+        // lists the occurrence dates that were edited into real rows.
+        "CREATE TABLE IF NOT EXISTS recurring_rules ("
+        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "    user_id INTEGER,"
+        "    trans_type TEXT,"
+        "    amount REAL,"
+        "    category TEXT,"
+        "    note TEXT,"
+        "    start_date TEXT,"
+        "    unit TEXT,"
+        "    every INTEGER,"
+        "    end_date TEXT,"
+        "    skipped TEXT NOT NULL DEFAULT ''"
+        ");"
+        "CREATE INDEX IF NOT EXISTS idx_recurring_rules_user "
+        "    ON recurring_rules(user_id);";
+
+    // Full-text index over category and note. The owner column holds one
+    // "u<user_id>" token so a search intersects with the user's postings
+    // instead of filtering every account's matches. Triggers keep it in
+    // the same transaction as the row change.
+    const char *search_sql =
+        "CREATE VIRTUAL TABLE transactions_fts USING fts5("
+        "    owner, category, note, prefix = '2 3'"
+        ");"
+        "INSERT INTO transactions_fts (rowid, owner, category, note) "
+        "    SELECT id, 'u' || user_id, category, note FROM transactions;";
+
+    const char *trigger_sql =
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_insert AFTER INSERT ON transactions BEGIN"
+        "    INSERT INTO transactions_fts (rowid, owner, category, note)"
+        "        VALUES (new.id, 'u' || new.user_id, new.category, new.note);"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_delete AFTER DELETE ON transactions BEGIN"
+        "    DELETE FROM transactions_fts WHERE rowid = old.id;"
+        "END;"
+        "CREATE TRIGGER IF NOT EXISTS transactions_fts_update AFTER UPDATE ON transactions BEGIN"
+        "    DELETE FROM transactions_fts WHERE rowid = old.id;"
+        "    INSERT INTO transactions_fts (rowid, owner, category, note)"
+        "        VALUES (new.id, 'u' || new.user_id, new.category, new.note);"
+        "END;";
+
+    char *err_msg = NULL;
+    int rc = sqlite3_exec(db, schema_sql, NULL, NULL, &err_msg);
+
+    // Databases created before the note column existed
+    if (rc == SQLITE_OK && !has_column(db, "transactions", "note")) {
+        rc = sqlite3_exec(db, "ALTER TABLE transactions ADD COLUMN note TEXT;", NULL, NULL, &err_msg);
+    }
+
+    // First run with search: create and backfill the index in one go
+    if (rc == SQLITE_OK && !has_table(db, "transactions_fts")) {
+        rc = sqlite3_exec(db, "BEGIN;", NULL, NULL, &err_msg);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db, search_sql, NULL, NULL, &err_msg);
+            sqlite3_exec(db, rc == SQLITE_OK ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
+        }
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, trigger_sql, NULL, NULL, &err_msg);
+    }
+
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error creating transactions schema: %s\n", err_msg);
+        sqlite3_free(err_msg);
+    }
+    return rc;
+}
+
+static sqlite3 *open_shard_db(const char *path, int flags);
+
+// -------------------------------------------------------------------
+// shard_meta: the recorded shard count lives next to the users table
+// -------------------------------------------------------------------
+static int ensure_meta_table(sqlite3 *db)
+{
+    return sqlite3_exec(db,
+        "CREATE TABLE IF NOT EXISTS shard_meta (name TEXT PRIMARY KEY, value INTEGER);",
+        NULL, NULL, NULL);
+}
+
+// Returns the recorded count, or 0 if none was recorded.
+static int read_recorded_count(sqlite3 *db)
+{
+    sqlite3_stmt *stmt;
+    int count = 0;
+
+    if (ensure_meta_table(db) != SQLITE_OK) {
+        return 0;
+    }
+    if (sqlite3_prepare_v2(db, "SELECT value FROM shard_meta WHERE name = 'shard_count';",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+static int write_recorded_count(sqlite3 *db, int count)
+{
+    char sql[128];
+    snprintf(sql, sizeof(sql),
+             "INSERT OR REPLACE INTO shard_meta (name, value) VALUES ('shard_count', %d);", count);
+    if (ensure_meta_table(db) != SQLITE_OK) {
+        return SQLITE_ERROR;
+    }
+    return sqlite3_exec(db, sql, NULL, NULL, NULL);
+}
+
+int shard_read_count(sqlite3 *users_db)
+{
+    int count = read_recorded_count(users_db);
+    return count > 0 ? count : 1;
+}
+
+// -------------------------------------------------------------------
+// Global id sequence (shard_meta row "next_id")
+// -------------------------------------------------------------------
+
+// HELPER: Integer result of a one-row query, or fallback.
+static long long query_int64(sqlite3 *db, const char *sql, long long fallback)
+{
+    sqlite3_stmt *stmt;
+    long long value = fallback;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            value = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return value;
+}
+
+// Takes count ids off the sequence; the first is stored in *first.
+static int reserve_ids(sqlite3 *main_db, long long count, long long *first)
+{
+    sqlite3_stmt *stmt;
+    int rc = -1;
+    if (sqlite3_prepare_v2(main_db,
+            "UPDATE shard_meta SET value = value + ?1 WHERE name = 'next_id' RETURNING value - ?1;",
+            -1, &stmt, NULL) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, count);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        *first = sqlite3_column_int64(stmt, 0);
+        rc = 0;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// HELPER: Highest transaction or rule id stored in a shard file.
+static long long max_id_of(sqlite3 *db)
+{
+    return query_int64(db,
+        "SELECT max(coalesce((SELECT max(id) FROM transactions), 0), "
+        "           coalesce((SELECT max(id) FROM recurring_rules), 0));", 0);
+}
+
+// Makes sure the sequence exists and lies above every id on disk, whatever
+// wrote the rows.
+static int prepare_id_sequence(sqlite3 *main_db, int count)
+{
+    long long next = 1;
+
+    // 1) Highest id over every shard file
+    for (int i = 0; i < count; i++) {
+        char path[64];
+        shard_path(i, path, sizeof(path));
+        if (i > 0 && access(path, F_OK) != 0) {
+            continue;
+        }
+        sqlite3 *db = i == 0 ? main_db : open_shard_db(path, SQLITE_OPEN_READWRITE);
+        if (!db) {
+            return -1;
+        }
+        long long max_id = max_id_of(db);
+        if (max_id >= next) {
+            next = max_id + 1;
+        }
+        if (db != main_db) {
+            sqlite3_close(db);
+        }
+    }
+
+    // 2) Never below that, never moved back
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "INSERT INTO shard_meta (name, value) VALUES ('next_id', %lld) "
+             "ON CONFLICT(name) DO UPDATE SET value = max(value, excluded.value);", next);
+    return ensure_meta_table(main_db) == SQLITE_OK &&
+           sqlite3_exec(main_db, sql, NULL, NULL, NULL) == SQLITE_OK ? 0 : -1;
+}
+
+// -------------------------------------------------------------------
+// HELPER: Open a shard file with the settings every writer uses.
+static sqlite3 *open_shard_db(const char *path, int flags)
+{
+    sqlite3 *db;
+    if (sqlite3_open_v2(path, &db, flags, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open shard %s: %s\n", path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    // New files keep freed pages reclaimable by maintenance.c's small
+    // incremental_vacuum steps (no effect once a file has tables)
+    sqlite3_exec(db, "PRAGMA auto_vacuum=INCREMENTAL;", NULL, NULL, NULL);
+
+    // WAL lets export/report readers run while the shard writer commits
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+
+    // When the WAL restarts after a checkpoint, cut the file back to 4MB
+    sqlite3_exec(db, "PRAGMA journal_size_limit=4194304;", NULL, NULL, NULL);
+
+    if (shard_ensure_schema(db) != SQLITE_OK) {
+        sqlite3_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+int shard_init(int count)
+{
+    if (count < 1 || count > SHARD_MAX) {
+        fprintf(stderr, "Shard count must be 1..%d\n", SHARD_MAX);
+        return -1;
+    }
+
+    // 1) Open every shard with its own connection and lock
+    for (int i = 0; i < count; i++) {
+        char path[64];
+        shard_path(i, path, sizeof(path));
+        g_shards[i].db = open_shard_db(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX);
+        if (!g_shards[i].db) {
+            g_shard_count = i;
+            shard_close();
+            return -1;
+        }
+        pthread_mutex_init(&g_shards[i].lock, NULL);
+    }
+    g_shard_count = count;
+
+    // 2) The layout on disk must match the requested count
+    sqlite3 *main_db = g_shards[0].db;
+    int recorded = read_recorded_count(main_db);
+    if (recorded == 0) {
+        // Legacy single-file database: only safe to spread out if it is empty
+        sqlite3_stmt *stmt;
+        int rows = 0;
+        if (sqlite3_prepare_v2(main_db, "SELECT EXISTS (SELECT 1 FROM transactions);", -1, &stmt, NULL) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                rows = sqlite3_column_int(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+        if (count > 1 && rows) {
+            fprintf(stderr, "transactions.db is not sharded yet; run ./shard_split %d first\n", count);
+            shard_close();
+            return -1;
+        }
+        write_recorded_count(main_db, count);
+    } else if (recorded != count) {
+        fprintf(stderr, "transactions.db is split into %d shards; run ./shard_rebalance %d to change it\n",
+                recorded, count);
+        shard_close();
+        return -1;
+    }
+
+    // 3) Global id sequence, and the connection that hands out its blocks
+    if (prepare_id_sequence(main_db, count) < 0 ||
+        !(g_sequence_db = open_shard_db("transactions.db", SQLITE_OPEN_READWRITE | SQLITE_OPEN_FULLMUTEX))) {
+        fprintf(stderr, "Cannot prepare the transaction id sequence\n");
+        shard_close();
+        return -1;
+    }
+    return 0;
+}
+
+void shard_close(void)
+{
+    for (int i = 0; i < g_shard_count; i++) {
+        sqlite3_close(g_shards[i].db);
+        g_shards[i].db = NULL;
+        g_shards[i].next_id = g_shards[i].id_limit = 0;
+        pthread_mutex_destroy(&g_shards[i].lock);
+    }
+    g_shard_count = 0;
+    sqlite3_close(g_sequence_db);
+    g_sequence_db = NULL;
+}
+
+void shard_set_wal_autocheckpoint(int pages)
+{
+    for (int i = 0; i < g_shard_count; i++) {
+        pthread_mutex_lock(&g_shards[i].lock);
+        sqlite3_wal_autocheckpoint(g_shards[i].db, pages);
+        pthread_mutex_unlock(&g_shards[i].lock);
+    }
+    pthread_mutex_lock(&g_sequence_lock);
+    if (g_sequence_db) {
+        sqlite3_wal_autocheckpoint(g_sequence_db, pages);
+    }
+    pthread_mutex_unlock(&g_sequence_lock);
+}
+
+long long shard_next_id(int user_id)
+{
+    if (g_shard_count == 0) {
+        return -1;
+    }
+    struct shard *shard = &g_shards[shard_of_user(user_id, g_shard_count)];
+    if (shard->next_id == shard->id_limit) {
+        // The reservation writes transactions.db: from inside a write
+        // transaction on shard 0 it would wait on the caller's own lock
+        if (shard == &g_shards[0] && sqlite3_txn_state(shard->db, NULL) == SQLITE_TXN_WRITE) {
+            fprintf(stderr, "shard_next_id called inside a write transaction on shard 0\n");
+            return -1;
+        }
+        long long first;
+        pthread_mutex_lock(&g_sequence_lock);
+        int rc = reserve_ids(g_sequence_db, SHARD_ID_BLOCK, &first);
+        pthread_mutex_unlock(&g_sequence_lock);
+        if (rc < 0) {
+            fprintf(stderr, "Reserving transaction ids failed: %s\n", sqlite3_errmsg(g_sequence_db));
+            return -1;
+        }
+        shard->next_id = first;
+        shard->id_limit = first + SHARD_ID_BLOCK;
+    }
+    return shard->next_id++;
+}
+
+sqlite3 *shard_acquire(int user_id)
+{
+    if (g_shard_count == 0) {
+        return NULL;
+    }
+    struct shard *shard = &g_shards[shard_of_user(user_id, g_shard_count)];
+    pthread_mutex_lock(&shard->lock);
+    return shard->db;
+}
+
+void shard_release(int user_id)
+{
+    if (g_shard_count == 0) {
+        return;
+    }
+    pthread_mutex_unlock(&g_shards[shard_of_user(user_id, g_shard_count)].lock);
+}
+
+// -------------------------------------------------------------------
+// Offline rebalancing (used by tools/shard_split.c & tools/shard_rebalance.c)
+// -------------------------------------------------------------------
+
+// SQL function shard_of(user_id, count) so rows can be moved set-wise
+static void sql_shard_of(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    (void)argc;
+    sqlite3_result_int(ctx, shard_of_user(sqlite3_value_int(argv[0]), sqlite3_value_int(argv[1])));
+}
+
+// Moves rows of `source` that belong to shard `target` under new_count,
+// keeping their ids. SQLite only commits atomically per WAL file, so the
+// move is two transactions: copy into the target and commit there, then
+// delete from the source exactly the ids the target now holds. Ids are
+// global, so an id already in the target is a copy from an interrupted
+// run, and running the tool again finishes the move.
+static int move_rows(sqlite3 *source, const char *source_path, int target, int new_count, long *moved)
+{
+    char target_path[64];
+    shard_path(target, target_path, sizeof(target_path));
+
+    // 1) Copy, committed in the target file only
+    sqlite3 *target_db = open_shard_db(target_path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (!target_db) {
+        return -1;
+    }
+    sqlite3_create_function(target_db, "shard_of", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                            NULL, sql_shard_of, NULL, NULL);
+
+    char *sql = sqlite3_mprintf(
+        "ATTACH DATABASE %Q AS source;"
+        "BEGIN IMMEDIATE;"
+        "INSERT OR IGNORE INTO main.recurring_rules (id, " SHARD_RECURRING_COLUMNS ") "
+        "    SELECT id, " SHARD_RECURRING_COLUMNS " FROM source.recurring_rules WHERE shard_of(user_id, %d) = %d;"
+        "INSERT OR IGNORE INTO main.transactions (id, " SHARD_TRANSACTION_COLUMNS ") "
+        "    SELECT id, " SHARD_TRANSACTION_COLUMNS " FROM source.transactions WHERE shard_of(user_id, %d) = %d;"
+        "COMMIT;",
+        source_path, new_count, target, new_count, target);
+
+    char *err_msg = NULL;
+    int rc = sqlite3_exec(target_db, sql, NULL, NULL, &err_msg);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Copying rows to %s failed: %s\n", target_path, err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_exec(target_db, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    sqlite3_exec(target_db, "DETACH DATABASE source;", NULL, NULL, NULL);
+    sqlite3_close(target_db);
+    if (rc != SQLITE_OK) {
+        return -1;
+    }
+
+    // 2) Delete what the target holds, committed in the source file only
+    sql = sqlite3_mprintf(
+        "ATTACH DATABASE %Q AS target;"
+        "BEGIN IMMEDIATE;"
+        "DELETE FROM main.recurring_rules WHERE shard_of(user_id, %d) = %d "
+        "    AND id IN (SELECT id FROM target.recurring_rules);"
+        "DELETE FROM main.transactions WHERE shard_of(user_id, %d) = %d "
+        "    AND id IN (SELECT id FROM target.transactions);",
+        target_path, new_count, target, new_count, target);
+
+    rc = sqlite3_exec(source, sql, NULL, NULL, &err_msg);
+    sqlite3_free(sql);
+    if (rc == SQLITE_OK) {
+        *moved += sqlite3_changes(source);
+        rc = sqlite3_exec(source, "COMMIT;", NULL, NULL, &err_msg);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Removing moved rows from %s failed: %s\n", source_path, err_msg);
+        sqlite3_free(err_msg);
+        sqlite3_exec(source, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    sqlite3_exec(source, "DETACH DATABASE target;", NULL, NULL, NULL);
+    return rc == SQLITE_OK ? 0 : -1;
+}
+
+int shard_rebalance(int old_count, int new_count)
+{
+    if (old_count < 1 || old_count > SHARD_MAX || new_count < 1 || new_count > SHARD_MAX) {
+        fprintf(stderr, "Shard counts must be 1..%d\n", SHARD_MAX);
+        return -1;
+    }
+
+    // 1) Check the recorded layout
+    sqlite3 *main_db = open_shard_db("transactions.db", SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (!main_db) {
+        return -1;
+    }
+    int recorded = shard_read_count(main_db);
+    if (recorded != old_count) {
+        fprintf(stderr, "transactions.db records %d shard(s), not %d\n", recorded, old_count);
+        sqlite3_close(main_db);
+        return -1;
+    }
+
+    // The sequence must lie above every id the moved rows keep
+    if (prepare_id_sequence(main_db, old_count) < 0) {
+        fprintf(stderr, "Cannot prepare the transaction id sequence\n");
+        sqlite3_close(main_db);
+        return -1;
+    }
+
+    // 2) For every old shard, push out the rows that now live elsewhere
+    for (int s = 0; s < old_count; s++) {
+        char source_path[64];
+        shard_path(s, source_path, sizeof(source_path));
+        if (access(source_path, F_OK) != 0) {
+            continue;
+        }
+
+        sqlite3 *source = open_shard_db(source_path, SQLITE_OPEN_READWRITE);
+        if (!source) {
+            sqlite3_close(main_db);
+            return -1;
+        }
+        sqlite3_create_function(source, "shard_of", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                NULL, sql_shard_of, NULL, NULL);
+
+        long moved = 0;
+        for (int t = 0; t < new_count; t++) {
+            if (t == s) {
+                continue;
+            }
+            if (move_rows(source, source_path, t, new_count, &moved) < 0) {
+                sqlite3_close(source);
+                sqlite3_close(main_db);
+                return -1;
+            }
+        }
+        printf("%s: moved %ld row(s)%s\n", source_path, moved,
+               s >= new_count ? " (shard retired, file can be removed)" : "");
+        sqlite3_close(source);
+    }
+
+    // 3) Record the new layout
+    int rc = write_recorded_count(main_db, new_count);
+    sqlite3_close(main_db);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to record the new shard count\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+// Transactions are spread over N SQLite files by a hash of user_id.
+// Shard 0 is always transactions.db (which also holds the users table), so
+// N = 1 is exactly the original single-file layout. Other shards are
+// transactions-shard-01.db, transactions-shard-02.db, ...
+
+#define SHARD_MAX 64
+
+// Opens one writer connection per shard and makes sure every shard has the
+// transactions schema. Refuses to start if count differs from the count
+// recorded in transactions.db (use the shard_split / shard_rebalance tools).
+// Returns 0 on success, -1 on failure.
+int shard_init(int count);
+
+// Closes every shard connection.
+void shard_close(void);
+
+// Shard count chosen by shard_init (0 before it is called).
+int shard_get_count(void);
+
+// Shard index (0..count-1) that owns user_id.
+int shard_of_user(int user_id, int count);
+
+// File name of shard index.
+void shard_path(int index, char *out, size_t out_size);
+
+// File name of the shard that owns user_id under the current count.
+void shard_path_for_user(int user_id, char *out, size_t out_size);
+
+// Sets the WAL auto-checkpoint threshold (pages) of every shard writer;
+// 0 leaves checkpoints to the maintenance thread.
+void shard_set_wal_autocheckpoint(int pages);
+
+// Locks and returns the shard connection that owns user_id. The caller
+// must not close it and must call shard_release() with the same user_id.
+// Returns NULL if shard_init has not run.
+sqlite3 *shard_acquire(int user_id);
+void shard_release(int user_id);
+
+// Id for a new transaction or recurring rule of user_id, unique across
+// every shard. Call between shard_acquire() and shard_release(), before
+// opening a write transaction (BEGIN IMMEDIATE) on the shard, and insert
+// it explicitly. Every SHARD_ID_BLOCK ids it writes the sequence in
+// transactions.db on its own connection, which a write transaction on
+// shard 0 would block; such calls fail at once instead of waiting.
+// Returns -1 if no id could be reserved.
+long long shard_next_id(int user_id);
+
+// Creates the transactions table and its indexes if they are missing.
+int shard_ensure_schema(sqlite3 *db);
+
+// Shard count recorded in transactions.db, or 1 if none was recorded yet.
+int shard_read_count(sqlite3 *users_db);
+
+// Offline tool helper: moves every user's rows from the old_count layout to
+// the new_count layout, keeping their ids, and records new_count. The
+// server must be stopped. An interrupted run leaves no row lost and is
+// finished by running it again with the same arguments.
+// Returns 0 on success, -1 on failure.
+int shard_rebalance(int old_count, int new_count);
+
+#endif
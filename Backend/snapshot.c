@@ -0,0 +1,98 @@
+/******************************************************************************
+ * snapshot.c
+ *
+ * File layout (native byte order; old and new process are the same build
+ * or at least the same machine):
+ *
+ *   header      magic, version, session user_id
+ *   login       usernames of the login cache (passwords are re-read from
+ *               the users table on load, never written here)
+ *   balance     per user, the non-zero days of the range-report index
+ *   admission   admit / shed counters
+ *
+ * Everything in it is a cache, so a bad or missing file only means a cold
+ * start, never wrong answers - as long as nothing is written between save
+ * and load, which the handoff guarantees by saving after the old process
+ * has stopped accepting.
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "admission.h"
+#include "balance.h"
+#include "login.h"
+
+#define SNAPSHOT_MAGIC   0x50414e53u    // "SNAP"
+#define SNAPSHOT_VERSION 3           // 3: range indexes without recurring points
+
+struct snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    int32_t session_user_id;
+};
+
+int snapshot_save(const char *path, int session_user_id)
+{
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        perror("snapshot fopen");
+        return -1;
+    }
+
+    struct snapshot_header header = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, session_user_id };
+    int rc = (fwrite(&header, sizeof(header), 1, f) == 1 &&
+              login_snapshot_write(f) == 0 &&
+              balance_snapshot_write(f) == 0 &&
+              admission_snapshot_write(f) == 0) ? 0 : -1;
+
+    if (fclose(f) != 0 || rc < 0 || rename(tmp_path, path) < 0) {
+        fprintf(stderr, "Cannot write snapshot %s\n", path);
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_load(const char *path, int *session_user_id)
+{
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return -1;
+    }
+
+    // 1) Header
+    struct snapshot_header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Ignoring snapshot %s: bad header\n", path);
+        fclose(f);
+        unlink(path);
+        return -1;
+    }
+    *session_user_id = header.session_user_id;
+
+    // 2) Sections in write order; stop at the first damaged one
+    int logins = login_snapshot_read(f);
+    int users = logins < 0 ? -1 : balance_snapshot_read(f);
+    if (users >= 0) {
+        admission_snapshot_read(f);
+    }
+    fclose(f);
+    unlink(path);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("Snapshot preloaded: %d logins, %d range indexes in %.1f ms\n",
+           logins < 0 ? 0 : logins, users < 0 ? 0 : users,
+           (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// Warm-restart snapshot: the in-memory state a new process would otherwise
+// rebuild slowly - logged-in session, login cache, range-report indexes and
+// the admission counters. Written by the old process during a handoff
+// (handoff.h) and read by the new one before it accepts connections.
+
+#define SNAPSHOT_PATH "server.snapshot"
+
+// Writes path atomically (temporary file + rename). Returns 0 or -1.
+int snapshot_save(const char *path, int session_user_id);
+
+// Loads path into the caches and deletes it. Returns 0, or -1 if the file
+// is missing or unreadable; whatever did not load is rebuilt on demand.
+int snapshot_load(const char *path, int *session_user_id);
+
+#endif
@@ -0,0 +1,51 @@
+/******************************************************************************
+ * storage.c
+ *
+ * Startup selection of the transaction storage engine. The route handlers
+ * keep their signatures and check storage_get_engine() where they touch
+ * transaction rows; SQLite stays the default.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "storage.h"
+#include "txlog.h"
+
+#define TXLOG_DIR    "txlog"
+#define TXLOG_SHARDS 4
+
+static enum storage_engine g_engine = STORAGE_SQLITE;
+
+int storage_init(const char *engine_name)
+{
+    if (engine_name == NULL || strcmp(engine_name, "sqlite") == 0) {
+        g_engine = STORAGE_SQLITE;
+        return 0;
+    }
+
+    if (strcmp(engine_name, "txlog") == 0) {
+        if (txlog_open(TXLOG_DIR, TXLOG_SHARDS) < 0) {
+            fprintf(stderr, "Cannot open transaction log in %s/\n", TXLOG_DIR);
+            return -1;
+        }
+        g_engine = STORAGE_TXLOG;
+        return 0;
+    }
+
+    fprintf(stderr, "Unknown storage engine: %s (expected sqlite or txlog)\n", engine_name);
+    return -1;
+}
+
+enum storage_engine storage_get_engine(void)
+{
+    return g_engine;
+}
+
+void storage_shutdown(void)
+{
+    if (g_engine == STORAGE_TXLOG) {
+        txlog_close();
+    }
+    g_engine = STORAGE_SQLITE;
+}
@@ -0,0 +1,20 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+// Which engine stores transactions. Users always live in SQLite.
+enum storage_engine {
+    STORAGE_SQLITE = 0,   // "transactions" table in transactions.db (default)
+    STORAGE_TXLOG         // append-only log under txlog/ (see txlog.h)
+};
+
+// Selects and opens the engine by name ("sqlite" or "txlog").
+// Returns 0 on success, -1 for an unknown name or a failed open.
+int storage_init(const char *engine_name);
+
+// Engine chosen by storage_init (STORAGE_SQLITE if never called).
+enum storage_engine storage_get_engine(void);
+
+// Flushes and closes the engine.
+void storage_shutdown(void);
+
+#endif
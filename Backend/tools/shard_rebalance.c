@@ -0,0 +1,48 @@
+/******************************************************************************
+ * shard_rebalance.c
+ *
+ * Changes the shard count of an already sharded database. Only users whose
+ * shard changes are moved; the recorded count is updated at the end.
+ * Stop the server first, then start it again with --shards <new_count>.
+ *
+ * Build & run from Backend/:
+ *   gcc -I. -o shard_rebalance tools/shard_rebalance.c shard.c -lsqlite3 -lpthread
+ *   ./shard_rebalance 8
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sqlite3.h>
+
+#include "shard.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <new_shard_count>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // 1) Current count comes from transactions.db itself
+    sqlite3 *db;
+    if (sqlite3_open_v2("transactions.db", &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Cannot open transactions.db: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return EXIT_FAILURE;
+    }
+    int old_count = shard_read_count(db);
+    sqlite3_close(db);
+
+    // 2) Move rows to the new layout
+    int new_count = atoi(argv[1]);
+    if (new_count == old_count) {
+        printf("Already using %d shard(s).\n", old_count);
+        return EXIT_SUCCESS;
+    }
+    if (shard_rebalance(old_count, new_count) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    printf("Rebalanced from %d to %d shard(s).\n", old_count, new_count);
+    return EXIT_SUCCESS;
+}
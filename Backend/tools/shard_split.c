@@ -0,0 +1,33 @@
+/******************************************************************************
+ * shard_split.c
+ *
+ * Splits an existing single-file transactions.db into N shards.
+ * Shard 0 stays in transactions.db; every other user's rows move to
+ * transactions-shard-NN.db. Stop the server first, then start it again
+ * with --shards N.
+ *
+ * Build & run from Backend/:
+ *   gcc -I. -o shard_split tools/shard_split.c shard.c -lsqlite3 -lpthread
+ *   ./shard_split 4
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "shard.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <shard_count>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int count = atoi(argv[1]);
+    if (shard_rebalance(1, count) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    printf("transactions.db split into %d shard(s).\n", count);
+    return EXIT_SUCCESS;
+}
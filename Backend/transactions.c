@@ -1,8 +1,9 @@
 /******************************************************************************
  * transactions.c
  *
- * Compile together with your main.c, home.c, login.c:
- *   gcc -o server main.c home.c login.c transactions.c -lsqlite3
+ * Compile together with your main.c, home.c, login.c (see README.md for the
+ * full list of sources):
+ *   gcc -o server main.c home.c login.c transactions.c ... -lsqlite3 -lpthread
  ******************************************************************************/
 
 #include <stdio.h>
@@ -10,6 +11,16 @@
 #include <sqlite3.h>
 #include <string.h>
 
+#include "transactions.h"
+#include "dates.h"
+#include "http.h"
+#include "recurring.h"
+#include "shard.h"
+#include "storage.h"
+#include "txlog.h"
+
+#define TXLOG_READ_BATCH 256
+
 // -------------------------------------------------------------------
 // HELPER: Convert a 2-digit month string ("01".."12") to a name ("January".."December").
 static const char* month_number_to_name(const char* monthNum)
@@ -29,6 +40,143 @@ static const char* month_number_to_name(const char* monthNum)
     return "Unknown";
 }
 
+// -------------------------------------------------------------------
+// HELPER: Append one formatted object to a JSON array being built.
+// Returns the (possibly moved) buffer.
+static char* append_json_row(char *json_result, int *first_record, const char *row_buffer)
+{
+    if (!*first_record) {
+        // Add comma between objects
+        json_result = realloc(json_result, strlen(json_result) + 2);
+        strcat(json_result, ",");
+    }
+    *first_record = 0;
+
+    // Append to the JSON array
+    size_t new_len = strlen(json_result) + strlen(row_buffer) + 1;
+    json_result = realloc(json_result, new_len + 1); // +1 for '\0'
+    strcat(json_result, row_buffer);
+    return json_result;
+}
+
+// -------------------------------------------------------------------
+// HELPER: Append one transaction object to a JSON array being built.
+static char* append_transaction_json(char *json_result, int *first_record,
+                                     int id, const char *trans_type, double amount,
+                                     const char *date, const char *category,
+                                     const char *note)
+{
+    // Format a JSON object for this row (every text column is escaped:
+    // stored rows may hold anything)
+    char type_esc[128];
+    char date_esc[128];
+    char category_esc[256];
+    char note_esc[1536];
+    http_json_escape(trans_type, type_esc, sizeof(type_esc));
+    http_json_escape(date, date_esc, sizeof(date_esc));
+    http_json_escape(category, category_esc, sizeof(category_esc));
+    http_json_escape(note, note_esc, sizeof(note_esc));
+
+    char row_buffer[2304];
+    snprintf(row_buffer, sizeof(row_buffer),
+             "{\"id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,\"date\":\"%s\",\"category\":\"%s\",\"note\":\"%s\"}",
+             id, type_esc, amount, date_esc, category_esc, note_esc);
+    return append_json_row(json_result, first_record, row_buffer);
+}
+
+// -------------------------------------------------------------------
+// Recurring occurrences up to today, merged into the list newest first.
+// Occurrences have no row id: "id" is "r<rule_id>-<date>" and rule_id
+// plus date identify them for POST /recurring/occurrence.
+// -------------------------------------------------------------------
+struct occurrence_merge {
+    struct recurring_rule *rules;
+    int rule_count;
+    struct recurring_occurrence *items;
+    int count;
+    int next;
+};
+
+// Must run before the caller borrows the user's shard (recurring_load does).
+static void occurrences_open(struct occurrence_merge *merge, int user_id)
+{
+    memset(merge, 0, sizeof(*merge));
+    merge->rule_count = recurring_load(user_id, &merge->rules);
+    if (merge->rule_count > 0) {
+        merge->count = recurring_collect(merge->rules, merge->rule_count, recurring_today(), &merge->items);
+    }
+    if (merge->rule_count < 0) merge->rule_count = 0;
+    if (merge->count < 0) merge->count = 0;
+}
+
+// Appends the pending occurrences dated after `date` (all of them if NULL).
+static char* occurrences_emit(char *json_result, int *first_record,
+                              struct occurrence_merge *merge, const char *date)
+{
+    while (merge->next < merge->count) {
+        const struct recurring_occurrence *o = &merge->items[merge->next];
+        const struct recurring_rule *rule = &merge->rules[o->rule_index];
+        char occurrence_date[16];
+        day_to_date(o->day, occurrence_date, sizeof(occurrence_date));
+        if (date && strcmp(occurrence_date, date) <= 0) {
+            break;
+        }
+
+        char type_esc[128];
+        char category_esc[256];
+        char note_esc[1536];
+        http_json_escape(rule->trans_type, type_esc, sizeof(type_esc));
+        http_json_escape(rule->category, category_esc, sizeof(category_esc));
+        http_json_escape(rule->note, note_esc, sizeof(note_esc));
+
+        char row_buffer[2304];
+        snprintf(row_buffer, sizeof(row_buffer),
+                 "{\"id\":\"r%d-%s\",\"rule_id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,\"date\":\"%s\",\"category\":\"%s\",\"note\":\"%s\"}",
+                 rule->id, occurrence_date, rule->id, type_esc, rule->amount,
+                 occurrence_date, category_esc, note_esc);
+        json_result = append_json_row(json_result, first_record, row_buffer);
+        merge->next++;
+    }
+    return json_result;
+}
+
+static void occurrences_close(struct occurrence_merge *merge)
+{
+    free(merge->items);
+    recurring_free(merge->rules, merge->rule_count);
+}
+
+// -------------------------------------------------------------------
+// METHOD 1 DATA (txlog engine): same array, read from the log newest first.
+// -------------------------------------------------------------------
+static char* get_transactions_raw_list_txlog(int user_id)
+{
+    struct txlog_record batch[TXLOG_READ_BATCH];
+    struct txlog_cursor cursor = {0};
+    size_t n;
+
+    char *json_result = strdup("[");
+    int first_record = 1;
+    struct occurrence_merge merge;
+    occurrences_open(&merge, user_id);
+
+    while ((n = txlog_read_user(user_id, &cursor, 1, batch, TXLOG_READ_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            json_result = occurrences_emit(json_result, &first_record, &merge, batch[i].date);
+            json_result = append_transaction_json(json_result, &first_record,
+                                                  batch[i].id, batch[i].trans_type,
+                                                  batch[i].amount_cents / 100.0,
+                                                  batch[i].date, batch[i].category, "");
+        }
+    }
+    json_result = occurrences_emit(json_result, &first_record, &merge, NULL);
+    occurrences_close(&merge);
+
+    json_result = realloc(json_result, strlen(json_result) + 2);
+    strcat(json_result, "]");
+    return json_result;
+}
+
 // -------------------------------------------------------------------
 // METHOD 1 DATA: Return a raw JSON array of individual transactions
 // (suitable for a “normal table” in your frontend).
@@ -37,7 +185,7 @@ static const char* month_number_to_name(const char* monthNum)
 //   [
 //     {
 //       "id": 6, "trans_type": "expense", "amount": 200.00,
-//       "date": "2025-01-17", "category": "Transport"
+//       "date": "2025-01-17", "category": "Transport", "note": "Bus pass"
 //     },
 //     ...
 //   ]
@@ -48,17 +196,25 @@ static char* get_transactions_raw_list(int user_id)
     sqlite3_stmt *res;
     int rc;
 
-    // 1) Open the database
-    rc = sqlite3_open("transactions.db", &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        return get_transactions_raw_list_txlog(user_id);
+    }
+
+    // 1) Expand recurring rules first (uses the shard itself), then borrow
+    //    the user's shard connection
+    struct occurrence_merge merge;
+    occurrences_open(&merge, user_id);
+
+    db = shard_acquire(user_id);
+    if (!db) {
+        fprintf(stderr, "Cannot open database: shards are not initialised\n");
+        occurrences_close(&merge);
         return strdup("{\"error\":\"Cannot open database\"}");
     }
 
     // 2) Prepare a query to select the needed columns
     const char *sql =
-        "SELECT id, trans_type, amount, date, category "
+        "SELECT id, trans_type, amount, date, category, note "
         "FROM transactions "
         "WHERE user_id = ? "
         "ORDER BY date DESC;";
@@ -66,7 +222,8 @@ static char* get_transactions_raw_list(int user_id)
     rc = sqlite3_prepare_v2(db, sql, -1, &res, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+        shard_release(user_id);
+        occurrences_close(&merge);
         return strdup("{\"error\":\"Failed to prepare statement\"}");
     }
 
@@ -75,43 +232,32 @@ static char* get_transactions_raw_list(int user_id)
 
     // 4) Build a JSON array string
     //    [
-    //      {"id":..., "trans_type":"...", "amount":..., "date":"...", "category":"..."},
+    //      {"id":..., "trans_type":"...", "amount":..., "date":"...", "category":"...", "note":"..."},
     //      ...
     //    ]
     char *json_result = strdup("[");
     int first_record = 1;
 
     while ((rc = sqlite3_step(res)) == SQLITE_ROW) {
-        if (!first_record) {
-            // Add comma between objects
-            json_result = realloc(json_result, strlen(json_result) + 2);
-            strcat(json_result, ",");
-        }
-        first_record = 0;
-
         // Extract each column
         int id = sqlite3_column_int(res, 0);
         const unsigned char *trans_type_raw = sqlite3_column_text(res, 1);
         double amount = sqlite3_column_double(res, 2);
         const unsigned char *date_raw = sqlite3_column_text(res, 3);
         const unsigned char *category_raw = sqlite3_column_text(res, 4);
+        const unsigned char *note_raw = sqlite3_column_text(res, 5);
 
         // Fallback if columns are NULL
         const char *trans_type = trans_type_raw ? (const char*)trans_type_raw : "";
         const char *date       = date_raw       ? (const char*)date_raw       : "";
         const char *category   = category_raw   ? (const char*)category_raw   : "";
+        const char *note       = note_raw       ? (const char*)note_raw       : "";
 
-        // Format a JSON object for this row
-        char row_buffer[512];
-        snprintf(row_buffer, sizeof(row_buffer),
-                 "{\"id\":%d,\"trans_type\":\"%s\",\"amount\":%.2f,\"date\":\"%s\",\"category\":\"%s\"}",
-                 id, trans_type, amount, date, category);
-
-        // Append to the JSON array
-        size_t new_len = strlen(json_result) + strlen(row_buffer) + 1;
-        json_result = realloc(json_result, new_len + 1); // +1 for '\0'
-        strcat(json_result, row_buffer);
+        json_result = occurrences_emit(json_result, &first_record, &merge, date);
+        json_result = append_transaction_json(json_result, &first_record,
+                                              id, trans_type, amount, date, category, note);
     }
+    json_result = occurrences_emit(json_result, &first_record, &merge, NULL);
 
     // 5) Close the array
     size_t final_len = strlen(json_result) + 2;  // for ']' + '\0'
@@ -120,70 +266,58 @@ static char* get_transactions_raw_list(int user_id)
 
     // 6) Clean up
     sqlite3_finalize(res);
-    sqlite3_close(db);
+    shard_release(user_id);
+    occurrences_close(&merge);
 
     return json_result;
 }
 
 // -------------------------------------------------------------------
-// METHOD 2 DATA: Return a Chart.js "bar" config object with dynamic
-// monthly sums for "expense" vs "income" based on the current user's data.
-//
-// We'll produce a JSON object like:
-//   {
-//     "type": "bar",
-//     "data": {
-//       "labels": ["January","February",...,"December"],
-//       "datasets": [
-//         {
-//           "label": "Expenses",
-//           "data": [ sum_for_Jan, sum_for_Feb, ... , sum_for_Dec ],
-//           "backgroundColor": "...",
-//           ...
-//         },
-//         {
-//           "label": "Income",
-//           "data": [ ... ],
-//           ...
-//         }
-//       ]
-//     },
-//     "options": {
-//       "scales": { "y": { "beginAtZero": true } }
-//     }
-//   }
+// Monthly expense and income sums for user_id (index 0 = January). Each
+// month shows the most recent year that has rows in it.
+// Returns 0 on success, -1 on a database error.
 // -------------------------------------------------------------------
-static char* get_barchart_config(int user_id)
+int get_monthly_totals(int user_id, double expenses[12], double income[12])
 {
     sqlite3 *db;
     sqlite3_stmt *stmt;
     int rc;
 
-    // We'll accumulate sums for each month (01..12)
-    double expenses[12] = {0};
-    double income[12]   = {0};
+    // We'll accumulate sums for each month (01..12), and the year each
+    // month's sum belongs to
+    int expense_year[12], income_year[12];
+    memset(expenses, 0, 12 * sizeof(double));
+    memset(income, 0, 12 * sizeof(double));
+    for (int i = 0; i < 12; i++) {
+        expense_year[i] = income_year[i] = RECURRING_NO_YEAR;
+    }
 
-    // 1) Open the database
-    rc = sqlite3_open("transactions.db", &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return strdup("{\"error\":\"Cannot open database\"}");
+    if (storage_get_engine() == STORAGE_TXLOG) {
+        txlog_monthly_totals(user_id, expenses, income, expense_year, income_year);
+        return recurring_monthly_totals(user_id, expenses, income, expense_year, income_year);
     }
 
-    // 2) Summation query for expenses by month
+    // 1) Borrow the user's shard connection
+    db = shard_acquire(user_id);
+    if (!db) {
+        fprintf(stderr, "Cannot open database: shards are not initialised\n");
+        return -1;
+    }
+
+    // 2) Summation query for expenses by month (per year-month; ordered so
+    //    the latest year of each month is read last and wins)
     const char *sql_expenses =
-        "SELECT strftime('%m', date) AS month_num, SUM(amount) "
+        "SELECT strftime('%m', date) AS month_num, SUM(amount), strftime('%Y', date) AS year_num "
         "FROM transactions "
         "WHERE user_id = ? AND trans_type = 'expense' "
         "GROUP BY strftime('%Y-%m', date) "
-        "ORDER BY month_num;";
+        "ORDER BY month_num, year_num;";
 
     rc = sqlite3_prepare_v2(db, sql_expenses, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement (expenses): %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return strdup("{\"error\":\"Failed to prepare statement for expenses\"}");
+        shard_release(user_id);
+        return -1;
     }
 
     // Bind user_id for expenses
@@ -198,6 +332,7 @@ static char* get_barchart_config(int user_id)
             int index = atoi((const char *)month_num) - 1;
             if (index >= 0 && index < 12) {
                 expenses[index] = sum_amount;
+                expense_year[index] = sqlite3_column_int(stmt, 2);
             }
         }
     }
@@ -205,17 +340,17 @@ static char* get_barchart_config(int user_id)
 
     // 3) Summation query for income by month
     const char *sql_income =
-        "SELECT strftime('%m', date) AS month_num, SUM(amount) "
+        "SELECT strftime('%m', date) AS month_num, SUM(amount), strftime('%Y', date) AS year_num "
         "FROM transactions "
         "WHERE user_id = ? AND trans_type = 'income' "
         "GROUP BY strftime('%Y-%m', date) "
-        "ORDER BY month_num;";
+        "ORDER BY month_num, year_num;";
 
     rc = sqlite3_prepare_v2(db, sql_income, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement (income): %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return strdup("{\"error\":\"Failed to prepare statement for income\"}");
+        shard_release(user_id);
+        return -1;
     }
 
     // Bind user_id for income
@@ -229,12 +364,57 @@ static char* get_barchart_config(int user_id)
             int index = atoi((const char *)month_num) - 1;
             if (index >= 0 && index < 12) {
                 income[index] = sum_amount;
+                income_year[index] = sqlite3_column_int(stmt, 2);
             }
         }
     }
     sqlite3_finalize(stmt);
 
-    // 4) We have arrays: expenses[0..11], income[0..11].
+    shard_release(user_id);
+
+    // 4) Recurring occurrences land in the same month buckets
+    return recurring_monthly_totals(user_id, expenses, income, expense_year, income_year);
+}
+
+// -------------------------------------------------------------------
+// METHOD 2 DATA: Return a Chart.js "bar" config object with dynamic
+// monthly sums for "expense" vs "income" based on the current user's data.
+//
+// We'll produce a JSON object like:
+//   {
+//     "type": "bar",
+//     "data": {
+//       "labels": ["January","February",...,"December"],
+//       "datasets": [
+//         {
+//           "label": "Expenses",
+//           "data": [ sum_for_Jan, sum_for_Feb, ... , sum_for_Dec ],
+//           "backgroundColor": "...",
+//           ...
+//         },
+//         {
+//           "label": "Income",
+//           "data": [ ... ],
+//           ...
+//         }
+//       ]
+//     },
+//     "options": {
+//       "scales": { "y": { "beginAtZero": true } }
+//     }
+//   }
+// -------------------------------------------------------------------
+static char* get_barchart_config(int user_id)
+{
+    // 1) Monthly sums for each month (01..12)
+    double expenses[12];
+    double income[12];
+
+    if (get_monthly_totals(user_id, expenses, income) != 0) {
+        return strdup("{\"error\":\"Cannot load monthly totals\"}");
+    }
+
+    // 2) We have arrays: expenses[0..11], income[0..11].
     //    Build a Chart.js config JSON:
     //    {
     //      "type":"bar",
@@ -289,7 +469,6 @@ static char* get_barchart_config(int user_id)
     // Note: Adjust backgroundColor, etc. as needed
     char *chart_json = malloc(5000);
     if (!chart_json) {
-        sqlite3_close(db);
         return strdup("{\"error\":\"Out of memory\"}");
     }
 
@@ -326,7 +505,6 @@ static char* get_barchart_config(int user_id)
         labels_json, expenses_json, income_json
     );
 
-    sqlite3_close(db);
     return chart_json;
 }
 
@@ -5,4 +5,8 @@
 // Caller must free the returned string.
 char* handle_get_transactions_request(int user_id);
 
+// Fills expenses[0..11] / income[0..11] with the user's per-month sums.
+// Returns 0 on success, -1 on a database error.
+int get_monthly_totals(int user_id, double expenses[12], double income[12]);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,689 @@
+/******************************************************************************
+ * txlog.c
+ *
+ * Append-only, fixed-width transaction log (one file per shard).
+ *
+ *   - Writes go through pwrite() at count * TXLOG_RECORD_SIZE. The file is
+ *     preallocated in doubling steps and mapped MAP_SHARED, so reads are
+ *     plain memory loads from the mapping.
+ *   - Durability is batched: fdatasync runs after TXLOG_SYNC_BATCH appends
+ *     or TXLOG_SYNC_INTERVAL_MS after the first unsynced append, whichever
+ *     comes first (group commit).
+ *   - Every shard keeps an in-memory index user_id -> record numbers,
+ *     sorted by (day, id), rebuilt by scanning the log on startup.
+ *     A record whose checksum does not match ends the log, which also
+ *     discards a torn write at the tail after a crash.
+ *   - A background thread does the timed syncs and compacts a shard once it
+ *     has doubled since the last compaction: the shard is rewritten
+ *     ordered by (user_id, day, id) so a user's records become contiguous,
+ *     and atomically renamed over the old file.
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dates.h"
+#include "txlog.h"
+
+#define TXLOG_SYNC_BATCH        64
+#define TXLOG_SYNC_INTERVAL_MS  50
+#define TXLOG_MIN_FILE_SIZE     (TXLOG_RECORD_SIZE * 16384)
+#define TXLOG_COMPACT_MIN       4096
+#define TXLOG_MAX_SHARDS        64
+
+#if defined(__APPLE__)
+#define fdatasync(fd) fsync(fd)
+#endif
+
+_Static_assert(sizeof(struct txlog_record) == TXLOG_RECORD_SIZE, "txlog record must be fixed width");
+
+struct txlog_entry {
+    int32_t day;
+    int32_t id;
+    uint32_t recno;
+};
+
+struct txlog_user {
+    int32_t user_id;          // 0 = empty slot
+    uint32_t count;
+    uint32_t cap;
+    struct txlog_entry *entries;
+};
+
+struct txlog_shard {
+    pthread_mutex_t lock;
+    char path[512];
+    int fd;
+    char *map;
+    size_t map_size;              // bytes mapped (== file size)
+    uint32_t count;               // valid records
+    uint32_t pending;             // appended but not yet fdatasync'd
+    uint32_t compacted_count;     // count right after the last compaction
+    struct txlog_user *users;     // open addressing, user_slots is a power of 2
+    uint32_t user_slots;
+    uint32_t user_count;
+};
+
+static struct txlog_shard g_shards[TXLOG_MAX_SHARDS];
+static char g_dir[256];
+static int g_shard_count = 0;
+static int32_t g_next_id = 1;
+static pthread_mutex_t g_id_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_compact_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t g_bg_thread;
+static int g_bg_running = 0;
+static pthread_mutex_t g_bg_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_bg_cond = PTHREAD_COND_INITIALIZER;
+
+// -------------------------------------------------------------------
+// HELPER: Record checksum over everything after the check field.
+static uint32_t record_check(const struct txlog_record *rec)
+{
+    const unsigned char *p = (const unsigned char *)rec + sizeof(rec->check);
+    uint32_t h = 2166136261u;
+    for (size_t i = sizeof(rec->check); i < TXLOG_RECORD_SIZE; i++) {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h | 1u;
+}
+
+static struct txlog_record *shard_record(struct txlog_shard *shard, uint32_t recno)
+{
+    return (struct txlog_record *)(shard->map + (size_t)recno * TXLOG_RECORD_SIZE);
+}
+
+static int entry_cmp(int32_t day_a, int32_t id_a, int32_t day_b, int32_t id_b)
+{
+    if (day_a != day_b) return day_a < day_b ? -1 : 1;
+    if (id_a != id_b) return id_a < id_b ? -1 : 1;
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Per-user index (open addressing on user_id)
+// -------------------------------------------------------------------
+static struct txlog_user *index_find(struct txlog_shard *shard, int32_t user_id)
+{
+    if (shard->user_slots == 0) {
+        return NULL;
+    }
+    uint32_t mask = shard->user_slots - 1;
+    uint32_t i = ((uint32_t)user_id * 2654435761u) & mask;
+    while (shard->users[i].user_id != 0) {
+        if (shard->users[i].user_id == user_id) {
+            return &shard->users[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+static struct txlog_user *index_slot(struct txlog_shard *shard, int32_t user_id)
+{
+    // Grow at 50% load so probes stay short
+    if ((shard->user_count + 1) * 2 > shard->user_slots) {
+        uint32_t new_slots = shard->user_slots ? shard->user_slots * 2 : 64;
+        struct txlog_user *new_users = calloc(new_slots, sizeof(*new_users));
+        if (!new_users) {
+            return NULL;
+        }
+        for (uint32_t i = 0; i < shard->user_slots; i++) {
+            struct txlog_user *u = &shard->users[i];
+            if (u->user_id == 0) continue;
+            uint32_t j = ((uint32_t)u->user_id * 2654435761u) & (new_slots - 1);
+            while (new_users[j].user_id != 0) {
+                j = (j + 1) & (new_slots - 1);
+            }
+            new_users[j] = *u;
+        }
+        free(shard->users);
+        shard->users = new_users;
+        shard->user_slots = new_slots;
+    }
+
+    uint32_t mask = shard->user_slots - 1;
+    uint32_t i = ((uint32_t)user_id * 2654435761u) & mask;
+    while (shard->users[i].user_id != 0) {
+        if (shard->users[i].user_id == user_id) {
+            return &shard->users[i];
+        }
+        i = (i + 1) & mask;
+    }
+    shard->users[i].user_id = user_id;
+    shard->user_count++;
+    return &shard->users[i];
+}
+
+// Index of the first entry ordered after (day, id).
+static uint32_t entries_upper_bound(const struct txlog_user *u, int32_t day, int32_t id)
+{
+    uint32_t lo = 0, hi = u->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (entry_cmp(u->entries[mid].day, u->entries[mid].id, day, id) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int index_add(struct txlog_shard *shard, const struct txlog_record *rec, uint32_t recno)
+{
+    struct txlog_user *u = index_slot(shard, rec->user_id);
+    if (!u) {
+        return -1;
+    }
+    if (u->count == u->cap) {
+        uint32_t new_cap = u->cap ? u->cap * 2 : 16;
+        struct txlog_entry *grown = realloc(u->entries, new_cap * sizeof(*grown));
+        if (!grown) {
+            return -1;
+        }
+        u->entries = grown;
+        u->cap = new_cap;
+    }
+
+    // Appends are almost always in order, so this is usually the tail
+    uint32_t pos = u->count;
+    if (pos > 0 && entry_cmp(u->entries[pos - 1].day, u->entries[pos - 1].id, rec->day, rec->id) > 0) {
+        pos = entries_upper_bound(u, rec->day, rec->id);
+        memmove(&u->entries[pos + 1], &u->entries[pos], (u->count - pos) * sizeof(*u->entries));
+    }
+    u->entries[pos].day = rec->day;
+    u->entries[pos].id = rec->id;
+    u->entries[pos].recno = recno;
+    u->count++;
+    return 0;
+}
+
+static void index_reset(struct txlog_shard *shard)
+{
+    for (uint32_t i = 0; i < shard->user_slots; i++) {
+        shard->users[i].count = 0;
+    }
+}
+
+// Scans the mapped log, counts valid records and indexes them.
+static void shard_scan(struct txlog_shard *shard)
+{
+    uint32_t capacity = (uint32_t)(shard->map_size / TXLOG_RECORD_SIZE);
+    uint32_t n = 0;
+
+    index_reset(shard);
+    while (n < capacity) {
+        struct txlog_record *rec = shard_record(shard, n);
+        if (rec->check != record_check(rec)) {
+            break;
+        }
+        index_add(shard, rec, n);
+
+        pthread_mutex_lock(&g_id_lock);
+        if (rec->id >= g_next_id) {
+            g_next_id = rec->id + 1;
+        }
+        pthread_mutex_unlock(&g_id_lock);
+        n++;
+    }
+    shard->count = n;
+}
+
+// -------------------------------------------------------------------
+// HELPER: Size fd to size bytes and map it. MAP_FAILED on error.
+static void *map_file(int fd, size_t size)
+{
+    if (ftruncate(fd, (off_t)size) < 0) {
+        perror("txlog ftruncate");
+        return MAP_FAILED;
+    }
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("txlog mmap");
+    }
+    return map;
+}
+
+// HELPER: Installs map as the shard's mapping, dropping the old one.
+static void shard_set_map(struct txlog_shard *shard, void *map, size_t size)
+{
+    if (shard->map) {
+        munmap(shard->map, shard->map_size);
+    }
+    shard->map = map;
+    shard->map_size = size;
+}
+
+// HELPER: (Re)map the shard file at the given size. On failure the old
+// mapping stays in place, so readers never see a missing map.
+static int shard_map(struct txlog_shard *shard, size_t size)
+{
+    void *map = map_file(shard->fd, size);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    shard_set_map(shard, map, size);
+    return 0;
+}
+
+static void shard_sync(struct txlog_shard *shard)
+{
+    if (shard->pending > 0) {
+        if (fdatasync(shard->fd) < 0) {
+            perror("txlog fdatasync");
+            return;
+        }
+        shard->pending = 0;
+    }
+}
+
+static struct txlog_shard *shard_for_user(int user_id)
+{
+    return &g_shards[(uint32_t)user_id % (uint32_t)g_shard_count];
+}
+
+// -------------------------------------------------------------------
+// Background thread: timed group sync + compaction
+// -------------------------------------------------------------------
+static void *txlog_background(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&g_bg_lock);
+    while (g_bg_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TXLOG_SYNC_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_bg_cond, &g_bg_lock, &deadline);
+        if (!g_bg_running) {
+            break;
+        }
+        pthread_mutex_unlock(&g_bg_lock);
+
+        txlog_sync();
+
+        for (int s = 0; s < g_shard_count; s++) {
+            struct txlog_shard *shard = &g_shards[s];
+            pthread_mutex_lock(&shard->lock);
+            uint32_t grown = shard->count - shard->compacted_count;
+            int due = grown >= TXLOG_COMPACT_MIN && grown >= shard->compacted_count;
+            pthread_mutex_unlock(&shard->lock);
+            if (due) {
+                txlog_compact(s);
+            }
+        }
+
+        pthread_mutex_lock(&g_bg_lock);
+    }
+    pthread_mutex_unlock(&g_bg_lock);
+    return NULL;
+}
+
+int txlog_open(const char *dir, int shard_count)
+{
+    if (shard_count < 1 || shard_count > TXLOG_MAX_SHARDS) {
+        fprintf(stderr, "txlog: shard count must be 1..%d\n", TXLOG_MAX_SHARDS);
+        return -1;
+    }
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        perror("txlog mkdir");
+        return -1;
+    }
+
+    snprintf(g_dir, sizeof(g_dir), "%s", dir);
+    g_shard_count = shard_count;
+    for (int s = 0; s < shard_count; s++) {
+        struct txlog_shard *shard = &g_shards[s];
+        memset(shard, 0, sizeof(*shard));
+        pthread_mutex_init(&shard->lock, NULL);
+        snprintf(shard->path, sizeof(shard->path), "%s/shard-%02d.log", dir, s);
+
+        // 1) Open and map the whole preallocated file
+        shard->fd = open(shard->path, O_RDWR | O_CREAT, 0644);
+        if (shard->fd < 0) {
+            perror("txlog open");
+            return -1;
+        }
+        struct stat st;
+        fstat(shard->fd, &st);
+        size_t size = (size_t)st.st_size;
+        size -= size % TXLOG_RECORD_SIZE;
+        if (size < TXLOG_MIN_FILE_SIZE) {
+            size = TXLOG_MIN_FILE_SIZE;
+        }
+        if (shard_map(shard, size) < 0) {
+            return -1;
+        }
+
+        // 2) Rebuild the per-user index from the valid prefix
+        shard_scan(shard);
+        shard->compacted_count = shard->count;
+    }
+
+    // 3) Start the sync/compaction thread
+    g_bg_running = 1;
+    if (pthread_create(&g_bg_thread, NULL, txlog_background, NULL) != 0) {
+        perror("txlog pthread_create");
+        g_bg_running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void txlog_close(void)
+{
+    if (g_bg_running) {
+        pthread_mutex_lock(&g_bg_lock);
+        g_bg_running = 0;
+        pthread_cond_signal(&g_bg_cond);
+        pthread_mutex_unlock(&g_bg_lock);
+        pthread_join(g_bg_thread, NULL);
+    }
+
+    for (int s = 0; s < g_shard_count; s++) {
+        struct txlog_shard *shard = &g_shards[s];
+        pthread_mutex_lock(&shard->lock);
+        shard_sync(shard);
+        if (shard->map) {
+            munmap(shard->map, shard->map_size);
+        }
+        close(shard->fd);
+        for (uint32_t i = 0; i < shard->user_slots; i++) {
+            free(shard->users[i].entries);
+        }
+        free(shard->users);
+        pthread_mutex_unlock(&shard->lock);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    g_shard_count = 0;
+}
+
+int txlog_fits(const char *type, const char *date, const char *category, const char *note)
+{
+    struct txlog_record rec;
+    return strlen(type) < sizeof(rec.trans_type) &&
+           strlen(date) < sizeof(rec.date) &&
+           strlen(category) < sizeof(rec.category) &&
+           (!note || note[0] == '\0');
+}
+
+int txlog_append(int user_id, const char *type, const char *amount,
+                 const char *date, const char *category, int *out_id)
+{
+    struct txlog_shard *shard = shard_for_user(user_id);
+    struct txlog_record rec;
+    int rc = -1;
+
+    if (!txlog_fits(type, date, category, NULL)) {
+        return -1;
+    }
+
+    // 1) Build the record outside the lock
+    memset(&rec, 0, sizeof(rec));
+    rec.user_id = user_id;
+    rec.amount_cents = llround(strtod(amount, NULL) * 100.0);
+    snprintf(rec.trans_type, sizeof(rec.trans_type), "%s", type);
+    snprintf(rec.date, sizeof(rec.date), "%s", date);
+    snprintf(rec.category, sizeof(rec.category), "%s", category);
+    int day;
+    rec.day = date_to_day(date, &day) ? day : TXLOG_NO_DAY;
+
+    pthread_mutex_lock(&g_id_lock);
+    rec.id = g_next_id++;
+    pthread_mutex_unlock(&g_id_lock);
+    rec.check = record_check(&rec);
+
+    pthread_mutex_lock(&shard->lock);
+
+    // 2) Grow the preallocated file (and the mapping) when full
+    size_t offset = (size_t)shard->count * TXLOG_RECORD_SIZE;
+    if (offset + TXLOG_RECORD_SIZE > shard->map_size) {
+        if (shard_map(shard, shard->map_size * 2) < 0) {
+            goto out;
+        }
+    }
+
+    // 3) Write, index, and sync if the batch is full
+    if (pwrite(shard->fd, &rec, sizeof(rec), (off_t)offset) != (ssize_t)sizeof(rec)) {
+        perror("txlog pwrite");
+        goto out;
+    }
+    if (index_add(shard, &rec, shard->count) < 0) {
+        goto out;
+    }
+    shard->count++;
+    shard->pending++;
+    if (shard->pending >= TXLOG_SYNC_BATCH) {
+        shard_sync(shard);
+    }
+
+    if (out_id) {
+        *out_id = rec.id;
+    }
+    rc = 0;
+
+out:
+    pthread_mutex_unlock(&shard->lock);
+    return rc;
+}
+
+size_t txlog_read_user(int user_id, struct txlog_cursor *cursor, int descending,
+                       struct txlog_record *out, size_t max)
+{
+    struct txlog_shard *shard = shard_for_user(user_id);
+    size_t n = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    struct txlog_user *u = index_find(shard, user_id);
+    if (!u || u->count == 0) {
+        pthread_mutex_unlock(&shard->lock);
+        return 0;
+    }
+
+    // Positions are recomputed from the (day, id) key on every call, so
+    // concurrent inserts never cause skipped or repeated records
+    if (!descending) {
+        uint32_t pos = cursor->started ? entries_upper_bound(u, cursor->day, cursor->id) : 0;
+        while (pos < u->count && n < max) {
+            out[n++] = *shard_record(shard, u->entries[pos++].recno);
+        }
+    } else {
+        uint32_t pos = u->count;
+        if (cursor->started) {
+            // First entry not ordered before (day, id)
+            uint32_t lo = 0, hi = u->count;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (entry_cmp(u->entries[mid].day, u->entries[mid].id, cursor->day, cursor->id) < 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            pos = lo;
+        }
+        while (pos > 0 && n < max) {
+            out[n++] = *shard_record(shard, u->entries[--pos].recno);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (n > 0) {
+        cursor->started = 1;
+        cursor->day = out[n - 1].day;
+        cursor->id = out[n - 1].id;
+    }
+    return n;
+}
+
+void txlog_monthly_totals(int user_id, double expenses[12], double income[12],
+                          int expense_year[12], int income_year[12])
+{
+    struct txlog_shard *shard = shard_for_user(user_id);
+    int64_t expense_cents[12] = {0};
+    int64_t income_cents[12] = {0};
+    for (int m = 0; m < 12; m++) {
+        expense_year[m] = income_year[m] = INT32_MIN;
+    }
+
+    // Entries run in day order, so a later year simply restarts the bucket
+    pthread_mutex_lock(&shard->lock);
+    struct txlog_user *u = index_find(shard, user_id);
+    for (uint32_t i = 0; u && i < u->count; i++) {
+        if (u->entries[i].day == TXLOG_NO_DAY) {
+            continue;
+        }
+        const struct txlog_record *rec = shard_record(shard, u->entries[i].recno);
+        int is_expense = strcmp(rec->trans_type, "expense") == 0;
+        if (!is_expense && strcmp(rec->trans_type, "income") != 0) {
+            continue;
+        }
+        int64_t *cents = is_expense ? expense_cents : income_cents;
+        int *year = is_expense ? expense_year : income_year;
+        int y, m, d;
+        day_to_civil(rec->day, &y, &m, &d);
+        if (y != year[m - 1]) {
+            year[m - 1] = y;
+            cents[m - 1] = 0;
+        }
+        cents[m - 1] += rec->amount_cents;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    for (int m = 0; m < 12; m++) {
+        expenses[m] = expense_cents[m] / 100.0;
+        income[m] = income_cents[m] / 100.0;
+    }
+}
+
+void txlog_sync(void)
+{
+    for (int s = 0; s < g_shard_count; s++) {
+        pthread_mutex_lock(&g_shards[s].lock);
+        shard_sync(&g_shards[s]);
+        pthread_mutex_unlock(&g_shards[s].lock);
+    }
+}
+
+static int record_order(const void *a, const void *b)
+{
+    const struct txlog_record *ra = a;
+    const struct txlog_record *rb = b;
+    if (ra->user_id != rb->user_id) {
+        return ra->user_id < rb->user_id ? -1 : 1;
+    }
+    return entry_cmp(ra->day, ra->id, rb->day, rb->id);
+}
+
+// Persists a rename in the log directory.
+static void sync_dir(void)
+{
+    int dfd = open(g_dir, O_RDONLY);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+}
+
+static int compact_locked(int s);
+
+int txlog_compact(int s)
+{
+    if (s < 0 || s >= g_shard_count) {
+        return -1;
+    }
+    // One compaction at a time: they share the temporary file name
+    pthread_mutex_lock(&g_compact_lock);
+    int rc = compact_locked(s);
+    pthread_mutex_unlock(&g_compact_lock);
+    return rc;
+}
+
+static int compact_locked(int s)
+{
+    struct txlog_shard *shard = &g_shards[s];
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.compact", shard->path);
+
+    // 1) Snapshot the record count; records below it are immutable
+    pthread_mutex_lock(&shard->lock);
+    uint32_t n = shard->count;
+    pthread_mutex_unlock(&shard->lock);
+
+    // 2) Read and sort them without holding the shard lock
+    struct txlog_record *recs = malloc((size_t)(n ? n : 1) * TXLOG_RECORD_SIZE);
+    if (!recs) {
+        return -1;
+    }
+    int rfd = open(shard->path, O_RDONLY);
+    if (rfd < 0 || pread(rfd, recs, (size_t)n * TXLOG_RECORD_SIZE, 0) != (ssize_t)((size_t)n * TXLOG_RECORD_SIZE)) {
+        perror("txlog compact read");
+        if (rfd >= 0) close(rfd);
+        free(recs);
+        return -1;
+    }
+    close(rfd);
+    qsort(recs, n, TXLOG_RECORD_SIZE, record_order);
+
+    int wfd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (wfd < 0 || write(wfd, recs, (size_t)n * TXLOG_RECORD_SIZE) != (ssize_t)((size_t)n * TXLOG_RECORD_SIZE)) {
+        perror("txlog compact write");
+        if (wfd >= 0) close(wfd);
+        unlink(tmp_path);
+        free(recs);
+        return -1;
+    }
+    free(recs);
+
+    // 3) Under the lock: copy the tail appended meanwhile, then swap files
+    pthread_mutex_lock(&shard->lock);
+    uint32_t tail = shard->count - n;
+    if (tail > 0 && write(wfd, shard_record(shard, n), (size_t)tail * TXLOG_RECORD_SIZE) !=
+                    (ssize_t)((size_t)tail * TXLOG_RECORD_SIZE)) {
+        perror("txlog compact tail");
+        pthread_mutex_unlock(&shard->lock);
+        close(wfd);
+        unlink(tmp_path);
+        return -1;
+    }
+    // Map the new file before it replaces the old one: if that fails the
+    // shard keeps its file and mapping unchanged
+    size_t size = shard->map_size;
+    void *map = fdatasync(wfd) < 0 ? MAP_FAILED : map_file(wfd, size);
+    if (map == MAP_FAILED || rename(tmp_path, shard->path) < 0) {
+        perror("txlog compact swap");
+        if (map != MAP_FAILED) {
+            munmap(map, size);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        close(wfd);
+        unlink(tmp_path);
+        return -1;
+    }
+
+    close(shard->fd);
+    shard->fd = wfd;
+    shard_set_map(shard, map, size);
+    shard_scan(shard);
+    shard->pending = 0;
+    shard->compacted_count = shard->count;
+    pthread_mutex_unlock(&shard->lock);
+
+    sync_dir();
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TXLOG_H
+#define TXLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only transaction log: an alternative to the SQLite "transactions"
+// table for append-and-aggregate workloads. Select it with --storage txlog.
+
+#define TXLOG_RECORD_SIZE   80
+#define TXLOG_CATEGORY_SIZE 36
+#define TXLOG_NO_DAY        INT32_MIN   // record has no (valid) date
+
+// On-disk record. Fixed width so record n lives at offset n * 80.
+struct txlog_record {
+    uint32_t check;          // FNV-1a of the remaining bytes; 0 never matches
+    int32_t  user_id;
+    int32_t  id;             // unique across all shards
+    int32_t  day;            // days since 1970-01-01, or TXLOG_NO_DAY
+    int64_t  amount_cents;
+    char     trans_type[8];
+    char     date[12];       // date exactly as entered (may be empty)
+    char     category[TXLOG_CATEGORY_SIZE];
+};
+
+// Position in a user's (day, id)-ordered record stream. Zero-initialise
+// to start from the beginning (or the end, when reading descending).
+struct txlog_cursor {
+    int started;
+    int32_t day;
+    int32_t id;
+};
+
+// Opens (creating if needed) shard_count log files under dir, rebuilds the
+// per-user indexes and starts the background sync/compaction thread.
+// Returns 0 on success, -1 on failure.
+int txlog_open(const char *dir, int shard_count);
+
+// Flushes pending records, stops the background thread and unmaps the logs.
+void txlog_close(void);
+
+// 1 if a row with these fields fits a record unchanged: type, date and
+// category within their fixed widths, and no note (records have no room
+// for one). Callers reject other rows instead of storing a cut-down copy.
+int txlog_fits(const char *type, const char *date, const char *category, const char *note);
+
+// Appends one transaction. The record is durable after the next group
+// sync (at most TXLOG_SYNC_BATCH records or TXLOG_SYNC_INTERVAL_MS later).
+// Returns 0 on success and stores the new id in *out_id when non-NULL;
+// -1 on failure, including fields that txlog_fits() rejects.
+int txlog_append(int user_id, const char *type, const char *amount,
+                 const char *date, const char *category, int *out_id);
+
+// Copies up to max of user_id's records that come after *cursor into out,
+// ordered by (day, id), ascending or descending, and advances the cursor.
+// Returns the number copied; 0 means the stream is exhausted.
+size_t txlog_read_user(int user_id, struct txlog_cursor *cursor, int descending,
+                       struct txlog_record *out, size_t max);
+
+// Sums the user's expense and income amounts per calendar month (index
+// 0..11), taking each month from the most recent year that has records in
+// it; that year goes to *_year (INT32_MIN for a month without records).
+void txlog_monthly_totals(int user_id, double expenses[12], double income[12],
+                          int expense_year[12], int income_year[12]);
+
+// Forces an fdatasync of every shard with unsynced records.
+void txlog_sync(void);
+
+// Rewrites a shard ordered by (user_id, day, id). Runs automatically from
+// the background thread; exposed for the benchmark. Returns 0 on success.
+int txlog_compact(int shard);
+
+#endif
@@ -1,8 +1,9 @@
-import React, { useState, useEffect } from 'react';
+import React, { useState } from 'react';
 import { Container, Box, Typography, Card, CardContent, TextField, Button, Paper } from '@mui/material';
 import { styled } from '@mui/material/styles';
 import Navbar from "../Components/NavBar";
 import Footer from "../Components/Footer";
+import { useTransactions } from "./useTransactions";
 
 const GEMINI_API_KEY = import.meta.env.VITE_GEMINI_API_KEY;
 
@@ -36,21 +37,10 @@ const parseBoldText = (text) => {
 };
 
 const AiChatPage = () => {
-  const [tableData, setTableData] = useState([]);
-  const [chartConfig, setChartConfig] = useState(null);
+  const { tableData } = useTransactions();
   const [messages, setMessages] = useState([]);
   const [userInput, setUserInput] = useState("");
 
-  useEffect(() => {
-    fetch('https://spendyze.duckdns.org/transactions')
-      .then((res) => res.json())
-      .then((data) => {
-        setTableData(data.method1 || []);
-        setChartConfig(data.method2 || null);
-      })
-      .catch((err) => console.error('Error fetching transactions:', err));
-  }, []);
-
   const handleSend = async () => {
     if (!userInput.trim()) return;
     setMessages((prev) => [...prev, { sender: 'user', text: userInput }]);
@@ -1,4 +1,4 @@
-import React, { useEffect, useState } from "react";
+import React from "react";
 import Navbar from "../Components/NavBar";
 import Footer from "../Components/Footer";
 import {
@@ -23,22 +23,12 @@ import {
   Legend
 } from "chart.js";
 import { Bar } from "react-chartjs-2";
+import { useTransactions } from "./useTransactions";
 
 ChartJS.register(CategoryScale, LinearScale, BarElement, Title, Tooltip, Legend);
 
 function ReportPage() {
-  const [tableData, setTableData] = useState([]);
-  const [chartConfig, setChartConfig] = useState(null);
-
-  useEffect(() => {
-    fetch("https://spendyze.duckdns.org/transactions")
-      .then((res) => res.json())
-      .then((data) => {
-        setTableData(data.method1);
-        setChartConfig(data.method2);
-      })
-      .catch((err) => console.error("Error fetching transactions:", err));
-  }, []);
+  const { tableData, chartConfig } = useTransactions();
 
   return (
     <>
@@ -75,6 +65,7 @@ function ReportPage() {
                         <TableCell>Amount</TableCell>
                         <TableCell>Date</TableCell>
                         <TableCell>Category</TableCell>
+                        <TableCell>Note</TableCell>
                       </TableRow>
                     </TableHead>
                     <TableBody>
@@ -84,6 +75,7 @@ function ReportPage() {
                           <TableCell>{tx.amount}</TableCell>
                           <TableCell>{tx.date}</TableCell>
                           <TableCell>{tx.category}</TableCell>
+                          <TableCell>{tx.note}</TableCell>
                         </TableRow>
                       ))}
                     </TableBody>
@@ -24,6 +24,8 @@ const AddTransaction = () => {
   const [date, setDate] = useState(null);
   const [category, setCategory] = useState("");
   const [customCategory, setCustomCategory] = useState("");
+  const [note, setNote] = useState("");
+  const [repeat, setRepeat] = useState("");
   const [successMessage, setSuccessMessage] = useState("");
   const [errorMessage, setErrorMessage] = useState("");
 
@@ -34,14 +36,19 @@ const AddTransaction = () => {
     e.preventDefault();
     setSuccessMessage("");
     setErrorMessage("");
-    const requestBody = JSON.stringify({
+    const fields = {
       type: transactionType,
       amount,
-      date: date ? date.format("YYYY-MM-DD") : "",
-      category: category || customCategory
-    });
+      category: category || customCategory,
+      note
+    };
+    const dateStr = date ? date.format("YYYY-MM-DD") : "";
+    // A repeating entry is saved once as a rule starting on the chosen date
+    const requestBody = JSON.stringify(
+      repeat ? { ...fields, start: dateStr, unit: repeat, every: "1" } : { ...fields, date: dateStr }
+    );
     try {
-      const response = await fetch("https://spendyze.duckdns.org/home", {
+      const response = await fetch(`https://spendyze.duckdns.org/${repeat ? "recurring" : "home"}`, {
         method: "POST",
         headers: { "Content-Type": "text/plain" },
         body: requestBody
@@ -162,6 +169,31 @@ const AddTransaction = () => {
                   required
                 />
               )}
+              <FormControl fullWidth>
+                <InputLabel id="repeat-label">Repeat</InputLabel>
+                <Select
+                  labelId="repeat-label"
+                  id="repeat"
+                  value={repeat}
+                  label="Repeat"
+                  onChange={(e) => setRepeat(e.target.value)}
+                >
+                  <MenuItem value="">Does not repeat</MenuItem>
+                  <MenuItem value="day">Daily</MenuItem>
+                  <MenuItem value="week">Weekly</MenuItem>
+                  <MenuItem value="month">Monthly</MenuItem>
+                  <MenuItem value="year">Yearly</MenuItem>
+                </Select>
+              </FormControl>
+              <TextField
+                label="Note (optional)"
+                variant="outlined"
+                value={note}
+                onChange={(e) => setNote(e.target.value)}
+                inputProps={{ maxLength: 255 }}
+                fullWidth
+                sx={{ gridColumn: { xs: "1", md: "1 / 3" } }}
+              />
               <Stack
                 direction="row"
                 justifyContent="center"
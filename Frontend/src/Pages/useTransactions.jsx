@@ -0,0 +1,83 @@
+import { useEffect, useState } from "react";
+
+const API = "https://spendyze.duckdns.org";
+
+// Loads /transactions each time the /events stream (re)connects, then stays
+// current from the stream: new rows and monthly totals arrive as small
+// deltas instead of re-fetching. Deltas that arrive while a load is in
+// flight are held back and merged by id once it resolves, so a row
+// committed around the fetch is neither lost nor overwritten.
+export function useTransactions() {
+  const [tableData, setTableData] = useState([]);
+  const [chartConfig, setChartConfig] = useState(null);
+
+  useEffect(() => {
+    let generation = 0;
+    let pending = null;
+
+    const addRow = (rows, tx) =>
+      rows.some((row) => row.id === tx.id)
+        ? rows
+        : [tx, ...rows].sort((a, b) => b.date.localeCompare(a.date));
+
+    const withMonthly = (config, monthly) => {
+      if (!config) return config;
+      const [expenses, income] = config.data.datasets;
+      return {
+        ...config,
+        data: {
+          ...config.data,
+          datasets: [
+            { ...expenses, data: monthly.expenses },
+            { ...income, data: monthly.income }
+          ]
+        }
+      };
+    };
+
+    const load = () => {
+      const current = ++generation;
+      pending = [];
+      fetch(`${API}/transactions`)
+        .then((res) => res.json())
+        .then((data) => {
+          if (current !== generation) return;
+          const rows = data.method1 || [];
+          // Only deltas missing from the response are newer than it
+          const newer = pending.filter(
+            (delta) => !rows.some((row) => row.id === delta.transaction.id)
+          );
+          setTableData(newer.reduce((acc, delta) => addRow(acc, delta.transaction), rows));
+          setChartConfig(
+            newer.length
+              ? withMonthly(data.method2 || null, newer[newer.length - 1].monthly)
+              : data.method2 || null
+          );
+        })
+        .catch((err) => console.error("Error fetching transactions:", err))
+        .finally(() => {
+          if (current === generation) pending = null;
+        });
+    };
+
+    const events = new EventSource(`${API}/events`);
+    events.addEventListener("open", load);
+    events.addEventListener("transaction", (e) => {
+      const delta = JSON.parse(e.data);
+      if (pending) {
+        pending.push(delta);
+        return;
+      }
+      setTableData((prev) => addRow(prev, delta.transaction));
+      setChartConfig((prev) => withMonthly(prev, delta.monthly));
+    });
+    // Recurring rule changes move many rows at once; re-read the list
+    events.addEventListener("recurring", load);
+    return () => {
+      generation++;
+      events.close();
+    };
+  }, []);
+
+  return { tableData, chartConfig };
+}